@@ -11,6 +11,7 @@
 #include "video.h"
 #include "player.h"
 #include "map.h"
+#include "log.h"
 
 
 #pragma mark - Environment
@@ -23,7 +24,7 @@ void A_UpdateWater (obj_t *water)
     water->glyph.character = CHAR_NUL;
     
     // draw a wave once and a while
-    if (Random() % 10000 < 7) // frequency of occurence
+    if (RandomEffect() % 10000 < 7) // frequency of occurence
     {
         water->glyph.character = '~';
         water->tics = 50; // length wave stays
@@ -41,7 +42,7 @@ void A_ExitContact (obj_t *exit, obj_t *hit)
             break;
             
         default:
-            List_RemoveObject(hit);
+            hit->state = objst_remove;
             break;
     }
 }
@@ -59,11 +60,11 @@ void A_Flicker (obj_t *obj)
     originalcolor = &objdefs[obj->type].glyph.fg_color;
     if (*currentcolor == *originalcolor) {
         *currentcolor = BRIGHTWHITE;
-        obj->updatedelay = Random() % 5;
+        obj->updatedelay = ObjRandom(obj, 0) % 5;
     }
     else {
         *currentcolor = *originalcolor;
-        obj->tics = (Random() % 5) + 12;
+        obj->tics = (ObjRandom(obj, 1) % 5) + 12;
     }
         
 }
@@ -86,8 +87,8 @@ A_SpawnProjectile
     obj_t proj;
     
     proj = NewObjectFromDef(type, src->x, src->y);
-    proj.src = src;
-    proj.dst = dst;
+    proj.src = src->id;
+    proj.dst = dst ? dst->id : NULL_HANDLE;
     proj.dx = dx;
     proj.dy = dy;
     proj.updatedelay = delay;
@@ -102,15 +103,18 @@ A_SpawnProjectile
 void A_UpdateProjectile (obj_t *proj)
 {
     obj_t * hit;
+    obj_t * target;
     int checkx, checky;
     
     if (--proj->tics > 0)
         return;
     
-    if (proj->dst) // projectile has a target, home
+    // projectile has a target, home (or keep going if it's gone)
+    target = List_Resolve(proj->dst);
+    if (target)
     {
-        proj->dx = sign(proj->dst->x - proj->x);
-        proj->dy = sign(proj->dst->y - proj->y);
+        proj->dx = sign(target->x - proj->x);
+        proj->dy = sign(target->y - proj->y);
     }
     
     if ( !TryMove(proj, proj->x + proj->dx, proj->y + proj->dy) )
@@ -134,18 +138,21 @@ void A_UpdateProjectile (obj_t *proj)
 
 void A_ProjectileContact (obj_t *proj, obj_t *hit)
 {
-    //printf("proj src: %s, hit: %s", ObjName(proj->src), ObjName(hit));
-    if (proj->src == hit)
+    obj_t *src;
+    
+    if (proj->src == hit->id)
         return;
 
     switch (hit->type)
     {
         case TYPE_PLAYER:
-            printf("player hit\n");
+            LogDebug("player hit");
             break;
             
         default:
-            DamageObj(proj->src, hit, proj->hp);
+            // the shooter may be dead by now
+            src = List_Resolve(proj->src);
+            DamageObj(src ? src : proj, hit, proj->hp);
             break;
     }
     
@@ -179,7 +186,7 @@ void A_SpiderUpdate (obj_t *sp)
     }
     else // spider is close, home in on player
     {
-        dir = Random() % 2; // pick a Random direction, x or y
+        dir = ObjRandom(sp, 1) % 2; // pick a Random direction, x or y
         switch (dir) {
             case 0: { // move in x dir
                 int newx = sp->x + sign(player.obj->x - sp->x);
@@ -196,7 +203,7 @@ void A_SpiderUpdate (obj_t *sp)
     
     // reset timer if no collision
     if (moved)
-        sp->tics = (Random() % 30) + 30;
+        sp->tics = (ObjRandom(sp, 2) % 30) + 30;
 }
 
 
@@ -227,7 +234,7 @@ void A_NessieUpdate (obj_t *n)
         {
             // dive
             n->state = objst_inactive;
-            n->tics = Random() % 90 + 240;
+            n->tics = ObjRandom(n, 0) % 90 + 240;
         }
         else if (n->state == objst_inactive)
         {
@@ -242,7 +249,7 @@ void A_NessieUpdate (obj_t *n)
     {
         // show char and shoot at halfway point
         n->glyph.character = objdefs[n->type].glyph.character;
-        damage = 5 * ((Random() % 3) + 1);
+        damage = 5 * ((ObjRandom(n, 1) % 3) + 1);
         if (n->tics == NESSIE_TIME / 2)
             A_SpawnProjectile(TYPE_PROJ_RING, n, player.obj, 0, 0, 10, damage);
     }
@@ -276,15 +283,14 @@ void A_OgreUpdate (obj_t *ogre)
     dy = sign(player.obj->y - ogre->y);
     if ( !TryMove(ogre, ogre->x + dx, ogre->y + dy) )
     {
-        tries = 20;
-        while (tries--) {
-            dx = (Random() % 3) - 1; // try a Random direction -1, 0, or 1
-            dy = (Random() % 3) - 1;
+        for (tries=0 ; tries<20 ; tries++) {
+            dx = (ObjRandom(ogre, tries * 2) % 3) - 1; // try a random direction -1, 0, or 1
+            dy = (ObjRandom(ogre, tries * 2 + 1) % 3) - 1;
             if ( TryMove(ogre, ogre->x + dx, ogre->y + dy) )
                 break;
         }
     }
-    ogre->tics = (Random() % 30) + 70;
+    ogre->tics = (ObjRandom(ogre, 40) % 30) + 70;
     if (ogre->hp <= 0)
         ogre->state = objst_remove;
 }
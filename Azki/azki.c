@@ -7,20 +7,34 @@
 //
 
 #include <SDL2/SDL.h>
+#include <stdio.h>
 #include <string.h>
 #include "azki.h"
 #include "video.h"
 #include "player.h"
 #include "map.h"
+#include "light.h"
+#include "world.h"
+#include "rewind.h"
+#include "levels.h"
+#include "watch.h"
+#include "input.h"
+#include "mem.h"
+#include "trace.h"
 
 #define MS_PER_FRAME 17
 
 int state;
 int tics;
 
+// PlayLoop restarts the level from its snapshot instead of the map
+bool restartlevel;
+
 char hudmsg[40];
 int hudtics;
 
+static bool showmemory;
+
 control_t gamecontrols[] =
 {
     { " ", " " },
@@ -36,6 +50,8 @@ control_t gamecontrols[] =
     { "QEZC", "Move diagonally NW/NE/SW/SE" },
     { "Arrows", "Shoot up/down/left/right" },
     { "TAB", "Show compass" },
+    { "F3", "Show memory use" },
+    { "F4", "Start/write trace" },
     { "stop", "stop" },
 };
 
@@ -73,6 +89,7 @@ void InitializeObjectList (void)
         {
             x = obj->x;
             y = obj->y;
+            obj->serial = y * MAP_W + x + 1;
             
             if (obj->type == TYPE_PLAYER)
                 player.obj = List_AddObject(obj);
@@ -199,6 +216,34 @@ void DrawCompass (void)
 
 
 
+//
+//  DrawMemory
+//  Heap use by subsystem over the map
+//
+void DrawMemory (void)
+{
+    char        line[64];
+    memstats_t  s;
+    pixel       y;
+    int         t;
+    
+    TextColor(BRIGHTWHITE);
+    y = maprect.y;
+    for (t=0 ; t<=NUMMEMTAGS ; t++, y+=TILE_SIZE)
+    {
+        if (t < NUMMEMTAGS)
+            Mem_GetStats(t, &s);
+        else
+            Mem_GetTotal(&s);
+        snprintf(line, sizeof(line), "%-6s %6zuK peak %6zuK %6d allocs",
+                 t < NUMMEMTAGS ? Mem_TagName(t) : "total",
+                 s.live / 1024, s.peak / 1024, s.allocs);
+        PrintString(line, maprect.x, y);
+    }
+}
+
+
+
 void GameKeyDown (SDL_Keycode key)
 {
     switch (key)
@@ -234,14 +279,17 @@ void GameKeyDown (SDL_Keycode key)
             break;
         }
         case SDLK_r: // reload level
-            if (CTRL) {
-                List_RemoveAll();
-                LoadMap(map.num, &map);
-                InitializeObjectList();
-                InitPlayer();
+            if (CTRL && W_RestoreSnapshot()) {
+                L_InitLighting();
+                R_Reset();
             }
             break;
             
+        case SDLK_BACKSPACE: // hold to rewind, CTRL to jump back
+            if (CTRL)
+                R_JumpBack();
+            break;
+            
         case SDLK_1:
             P_SwitchWeapon(WEAPON_SWORD);
             break;
@@ -252,6 +300,18 @@ void GameKeyDown (SDL_Keycode key)
         case SDLK_F1:
             S_Controls("GAME CONTROLS", gamecontrols);
             break;
+        case SDLK_F3:
+            showmemory = !showmemory;
+            break;
+        case SDLK_F4: // record, then write, a trace
+            if (tracing) {
+                Trace_Stop();
+                HUDMessage("Trace written");
+            } else {
+                Trace_Start(NULL);
+                HUDMessage("Tracing...");
+            }
+            break;
             
         default:
             break;
@@ -272,23 +332,15 @@ void DoGameInput (void)
                 break;
                 
             case SDL_KEYDOWN:
-                GameKeyDown(event.key.keysym.sym);
+                if (!Input_Event(&event))
+                    GameKeyDown(event.key.keysym.sym);
                 break;
                 
             case SDL_KEYUP:
-                switch (event.key.keysym.sym)
-                {
-                    case SDLK_UP:
-                    case SDLK_DOWN:
-                    case SDLK_LEFT:
-                    case SDLK_RIGHT:
-                        sword_dir = DIR_NONE;
-                        break;
-                    default:
-                        break;
-                }
+                Input_Event(&event);
                 break;
             default:
+                Watch_HandleEvent(&event);
                 break;
             }
         }
@@ -299,66 +351,119 @@ void DoGameInput (void)
 
 
 
-void PlayLoop (void)
+//
+//  RunTick
+//  Advance the world one tick: input, updates, contacts and removals
+//
+void RunTick (void)
 {
     obj_t *obj, *check;
     
-    InitPlayer();
-    InitializeObjectList();
+    P_PlayerInput();
+        
+    // update positions
+    List_UpdateObjects();
     
-    tics = 0;
+    // handle any collisions, in list order
+    obj = objlist;
+    do {
+        if (obj->state)
+        {
+            check = obj->next;
+            while (check)
+            {
+                if (check->state &&
+                    check->x == (int)obj->x && // use interger tile coords!
+                    check->y == (int)obj->y)
+                {
+                    if (obj->contact)
+                        obj->contact(obj, check);
+                    if (check->contact)
+                        check->contact(check, obj);
+                    
+                    if (!obj->state) // check removed obj
+                        break;
+                }
+                check = check->next;
+            }
+        }
+        obj = obj->next;
+    } while (obj);
+
+    // remove removables
+    obj = objlist;
+    do {
+        if ( obj->state == objst_remove )
+            obj = List_RemoveObject(obj);
+        else
+            obj = obj->next;
+    } while (obj);
+    
+    UpdateMapObjects(&map);
+    tics++;
+}
+
+
+
+void PlayLoop (void)
+{
+    int frames;
+    int ticks;
+    bool EditorTestMap (map_t *map);
+    
+    if (!restartlevel || !W_RestoreSnapshot())
+    {
+        if (restartlevel && !EditorTestMap(&map)) // map changed on disk
+            LoadMap(map.num, &map);
+        InitPlayer();
+        InitializeObjectList();
+        tics = 0;
+        W_CaptureSnapshot();
+    }
+    restartlevel = false;
+    Input_Reset();
+    StartTicks();
+    L_InitLighting();
+    R_Reset();
+    PrefetchLevel(AdjacentLevel(map.num, +1));
+    
+    frames = 0;
     do
     {
         StartFrame();
+        TraceBegin("frame");
+        if (frames++)
+            Mem_StartFrame(); // after the first, frames should allocate nothing
+        TraceBegin("input");
         DoGameInput();
+        TraceEnd("input");
         
-        P_PlayerInput();
-            
         // UPDATE
-                
-        // update positions
-        obj = objlist;
-        do {
-            if (obj->update)
-                obj->update(obj);
-            obj = obj->next;
-        } while (obj);
         
-        // handle any collisions
-        obj = objlist;
-        do {
-            if (obj->state)
+        // ticks are FRAME_RATE ms of game time whatever the present rate,
+        // so a frame may run none or several
+        TraceBegin("tick");
+        for (ticks = FrameTicks(FRAME_RATE) ; ticks && state == STATE_PLAY ; ticks--)
+        {
+            Input_StartTick(tics);
+            if (keys[SDL_SCANCODE_BACKSPACE] && !CTRL)
             {
-                check = obj->next;
-                while (check)
-                {
-                    if (check->state &&
-                        check->x == (int)obj->x && // use interger tile coords!
-                        check->y == (int)obj->y)
-                    {
-                        if (obj->contact)
-                            obj->contact(obj, check);
-                        if (check->contact)
-                            check->contact(check, obj);
-                        
-                        if (!obj->state) // check removed obj
-                            break;
-                    }
-                    check = check->next;
-                }
+                R_StepBack(); // rewind instead
             }
-            obj = obj->next;
-        } while (obj);
-
-        // remove removables
-        obj = objlist;
-        do {
-            if ( obj->state == objst_remove )
-                obj = List_RemoveObject(obj);
             else
-                obj = obj->next;
-        } while (obj);
+            {
+                RunTick();
+                R_RecordTick();
+            }
+            if (hudtics)
+                --hudtics;
+        }
+        TraceEnd("tick");
+        TraceBegin("lighting");
+        L_UpdateLighting();
+        TraceEnd("lighting");
 
+        TraceBegin("draw");
         Clear(0, 0, 0);
 //        TextColor(RED);
         
@@ -366,7 +471,6 @@ void PlayLoop (void)
         {
             TextColor(YELLOW);
             PrintString(hudmsg, BottomHUD.x, BottomHUD.y);
-            --hudtics;
         }
         P_DrawHealth();
         P_DrawInventory();
@@ -378,13 +482,27 @@ void PlayLoop (void)
         {
             DrawCompass();
         }
+        if (showmemory)
+            DrawMemory();
         
         PrintMapName();
+        TraceEnd("draw");
+        TraceBegin("present");
         Refresh();
+        TraceEnd("present");
+        Input_Presented();
+        Mem_EndFrame();
         
-        tics++;
+        TraceBegin("wait");
         LimitFrameRate(FRAME_RATE);
+        TraceEnd("wait");
+        TraceEnd("frame");
     } while (state == STATE_PLAY);
     
+    // try again from the same starting point
+    if (state == STATE_GAMEOVER)
+        restartlevel = true;
+    
+    Input_ReportLatency();
     List_RemoveAll();
 }
@@ -10,10 +10,12 @@
 #define azki_h
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define DEVELOPMENT
 #define TILE_SIZE       8       // tiles are 8 x 8 pixels
 #define CTRL            (keys[SDL_SCANCODE_LCTRL] || keys[SDL_SCANCODE_RCTRL])
+#define SHIFT           (keys[SDL_SCANCODE_LSHIFT] || keys[SDL_SCANCODE_RSHIFT])
 #define FRAME_RATE      16
 #define CONTROL_KEY_LEN     12
 #define CONTROL_ACTION_LEN  32
@@ -39,9 +41,12 @@ extern int state;
 extern const uint8_t * keys;
 
 extern int tics;
+extern bool restartlevel;
 
 void Quit (const char * error);
 void PlayLoop (void);
+void InitializeObjectList (void);
+void RunTick (void);
 void HUDMessage(const char * msg);
 void UpdateDeathMessage (const char * msg);
 
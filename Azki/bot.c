@@ -0,0 +1,445 @@
+//
+//  bot.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Autoplay bot, for soak tests and level balance runs. It plays through
+//  the same per-tick buttons as the keyboard (Input_SetButtons) and
+//  reads the world the way a player would see it:
+//
+//  - an enemy next to the player gets the sword, one in line and in
+//    range gets the bazooka if we have it
+//  - otherwise walk the shortest path to the nearest item we could use,
+//    through doors we have keys for, and then to the exit
+//  - if there's no path, cut one through breakable tiles
+//  - if nothing is reachable, or we haven't moved in a while, wander
+//
+//  Bot_Play runs a whole level without a window, as fast as it goes.
+//  The game's state is global, so one process plays one session at a
+//  time; azki-maptool -bot runs sessions in parallel as processes.
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "bot.h"
+#include "azki.h"
+#include "player.h"
+#include "input.h"
+#include "rng.h"
+#include "cmdlib.h"
+#include "mem.h"
+#include "log.h"
+
+#define BOT_RANGE       10      // tiles the bazooka is worth firing across
+#define BOT_STUCK       60      // ticks without moving before wandering
+#define BOT_WANDER      30      // ticks to wander for
+#define BOT_TURN        10      // ticks between turns when wandering
+
+typedef enum
+{
+    GOAL_NONE,
+    GOAL_ITEM,
+    GOAL_EXIT
+} goal_t;
+
+// the eight moves, in the order a path search tries them
+static const int movedx[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+static const int movedy[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+static const button_t movebuttons[8] =
+{
+    BT_NORTH, BT_SOUTH, BT_WEST, BT_EAST,
+    BT_NORTHWEST, BT_NORTHEAST, BT_SOUTHWEST, BT_SOUTHEAST
+};
+
+static struct
+{
+    rng_t       rng;        // its own, so it doesn't change the game's
+    int         lastx;
+    int         lasty;
+    int         still;      // ticks at the same tile
+    int         wander;     // ticks left to wander
+    int         wanderdir;
+    bool        attacked;   // let go of attack every other tick to swing again
+
+    byte        goals[MAP_H][MAP_W];
+    byte        blocked[MAP_H][MAP_W];
+    int16_t     from[MAP_H * MAP_W];    // path search: the cell we came from
+} bot;
+
+
+
+//
+//  Bot_Start
+//  Reset the bot for a new level
+//
+void Bot_Start (uint64_t seed)
+{
+    Rng_Seed(&bot.rng, seed ^ 0xB07B07B07ULL);
+    bot.lastx = bot.lasty = -1;
+    bot.still = 0;
+    bot.wander = 0;
+    bot.attacked = false;
+}
+
+
+static void Wander (void)
+{
+    bot.wander = BOT_WANDER;
+    bot.wanderdir = Rng_Range(&bot.rng, 8);
+}
+
+
+static bool Useful (const obj_t *obj)
+{
+    switch (obj->type)
+    {
+        case TYPE_GOLDKEY:
+            return !player.items.goldkey;
+        case TYPE_BLUEKEY:
+            return !player.items.bluekey;
+        case TYPE_GREENKEY:
+            return !player.items.greenkey;
+        case TYPE_BOAT:
+            return !player.items.boat;
+        case TYPE_BAZOOKA:
+            return !player.weapons[WEAPON_BAZOOKA];
+        case TYPE_HEART:
+            return player.obj->hp < player.maxhealth;
+        default:
+            return false;
+    }
+}
+
+
+static bool IsEnemy (const obj_t *obj)
+{
+    return obj->state == objst_active && obj->hp > 0
+        && ((obj->flags & OF_DAMAGING) || obj->type == TYPE_NESSIE);
+}
+
+
+//
+//  Passable
+//  Whether the player can step onto a tile, as P_UpdatePlayer would let it
+//
+static bool Passable (int x, int y, bool breaking)
+{
+    const obj_t *tile;
+
+    if (x < 0 || x >= MAP_W || y < 0 || y >= MAP_H || bot.blocked[y][x])
+        return false;
+
+    tile = &map.foreground[y][x];
+    switch (tile->type)
+    {
+        case TYPE_DOOR:
+            return true;
+        case TYPE_GOLDDOOR:
+            return player.items.goldkey;
+        case TYPE_BLUEDOOR:
+            return player.items.bluekey;
+        case TYPE_GREENDOOR:
+            return player.items.greenkey;
+        case TYPE_WATER:
+            return player.items.boat;
+        default:
+            break;
+    }
+
+    if (tile->flags & OF_BREAKABLE)
+        return breaking;
+    return !(tile->flags & OF_SOLID);
+}
+
+
+static void MarkWorld (void)
+{
+    obj_t *obj;
+
+    memset(bot.goals, GOAL_NONE, sizeof(bot.goals));
+    memset(bot.blocked, 0, sizeof(bot.blocked));
+    for (obj=objlist ; obj ; obj=obj->next)
+    {
+        if (obj->state == objst_remove || obj == player.obj)
+            continue;
+        if (obj->type == TYPE_BLOCK)
+            bot.blocked[obj->y][obj->x] = true;
+        else if (obj->type == TYPE_EXIT)
+            bot.goals[obj->y][obj->x] = GOAL_EXIT;
+        else if (Useful(obj))
+            bot.goals[obj->y][obj->x] = GOAL_ITEM;
+    }
+}
+
+
+//
+//  FindPath
+//  Breadth first from the player to the nearest item, or the exit if no
+//  item can be reached. Returns the first move, -1 if there's no path.
+//  Breakable tiles can only be stepped into straight on, to hit them.
+//
+static int FindPath (bool breaking)
+{
+    static int16_t queue[MAP_W * MAP_H];
+    int head, tail, cell, start, exitcell, goal;
+    int x, y, nx, ny, m;
+    bool breakable;
+
+    for (cell=0 ; cell<MAP_W*MAP_H ; cell++)
+        bot.from[cell] = -1;
+
+    start = player.obj->y * MAP_W + player.obj->x;
+    bot.from[start] = start;
+    queue[0] = start;
+    head = 0;
+    tail = 1;
+    exitcell = -1;
+    goal = -1;
+
+    while (head < tail)
+    {
+        cell = queue[head++];
+        x = cell % MAP_W;
+        y = cell / MAP_W;
+
+        if (cell != start)
+        {
+            if (bot.goals[y][x] == GOAL_ITEM) {
+                goal = cell;
+                break;
+            }
+            if (bot.goals[y][x] == GOAL_EXIT && exitcell == -1)
+                exitcell = cell;
+        }
+
+        for (m=0 ; m<8 ; m++)
+        {
+            nx = x + movedx[m];
+            ny = y + movedy[m];
+            if (!Passable(nx, ny, breaking) || bot.from[ny * MAP_W + nx] != -1)
+                continue;
+
+            breakable = map.foreground[ny][nx].flags & OF_BREAKABLE;
+            if (breakable && m >= 4)
+                continue;
+            bot.from[ny * MAP_W + nx] = cell;
+            queue[tail++] = ny * MAP_W + nx;
+        }
+    }
+
+    if (goal == -1)
+        goal = exitcell;
+    if (goal == -1)
+        return -1;
+
+    // back up to the first step
+    while (bot.from[goal] != start)
+        goal = bot.from[goal];
+    for (m=0 ; m<8 ; m++)
+        if (goal == (player.obj->y + movedy[m]) * MAP_W + player.obj->x + movedx[m])
+            return m;
+    return -1;
+}
+
+
+static uint32_t Attack (dir_t dir)
+{
+    static const button_t attacks[] =
+    {
+        NUMBUTTONS, BT_ATTACKEAST, BT_ATTACKNORTH, BT_ATTACKWEST, BT_ATTACKSOUTH
+    };
+
+    bot.attacked = !bot.attacked;
+    return bot.attacked ? 1 << attacks[dir] : 0;
+}
+
+
+// clear line from the player to x, y in a row or column
+static bool ClearShot (int x, int y)
+{
+    int dx, dy, cx, cy;
+
+    dx = sign(x - player.obj->x);
+    dy = sign(y - player.obj->y);
+    cx = player.obj->x + dx;
+    cy = player.obj->y + dy;
+    for ( ; cx != x || cy != y ; cx += dx, cy += dy)
+        if (map.foreground[cy][cx].flags & OF_SOLID)
+            return false;
+    return true;
+}
+
+
+static dir_t Direction (int dx, int dy)
+{
+    if (dx > 0)
+        return DIR_EAST;
+    if (dx < 0)
+        return DIR_WEST;
+    return dy < 0 ? DIR_NORTH : DIR_SOUTH;
+}
+
+
+//
+//  Fight
+//  Attack buttons for the closest enemy worth attacking, 0 if none
+//
+static uint32_t Fight (void)
+{
+    obj_t *obj, *target;
+    int dx, dy, dist, best;
+    bool adjacent;
+
+    target = NULL;
+    best = BOT_RANGE + 1;
+    for (obj=objlist ; obj ; obj=obj->next)
+    {
+        if (!IsEnemy(obj))
+            continue;
+        dx = obj->x - player.obj->x;
+        dy = obj->y - player.obj->y;
+        if (dx && dy)
+            continue; // can only attack in straight lines
+        dist = abs(dx) + abs(dy);
+        adjacent = dist == 1;
+        if (!adjacent && (!player.weapons[WEAPON_BAZOOKA] || !ClearShot(obj->x, obj->y)))
+            continue;
+        if (dist < best) {
+            best = dist;
+            target = obj;
+        }
+    }
+
+    if (!target)
+        return 0;
+
+    if (best == 1 && player.current_weapon != WEAPON_SWORD)
+        P_SwitchWeapon(WEAPON_SWORD);
+    else if (best > 1 && player.current_weapon != WEAPON_BAZOOKA)
+        P_SwitchWeapon(WEAPON_BAZOOKA);
+
+    return Attack(Direction(target->x - player.obj->x, target->y - player.obj->y));
+}
+
+
+//
+//  Bot_Think
+//  The buttons to hold this tick
+//
+uint32_t Bot_Think (void)
+{
+    uint32_t buttons;
+    obj_t *pl;
+    int m, nx, ny;
+
+    pl = player.obj;
+    if (pl->x == bot.lastx && pl->y == bot.lasty) {
+        if (++bot.still == BOT_STUCK) {
+            Wander();
+            bot.still = 0;
+        }
+    } else {
+        bot.still = 0;
+    }
+    bot.lastx = pl->x;
+    bot.lasty = pl->y;
+
+    if ((buttons = Fight()) != 0)
+        return buttons;
+
+    if (bot.wander)
+    {
+        if (--bot.wander % BOT_TURN == 0)
+            bot.wanderdir = Rng_Range(&bot.rng, 8);
+        return 1 << movebuttons[bot.wanderdir];
+    }
+
+    MarkWorld();
+    m = FindPath(false);
+    if (m == -1)
+        m = FindPath(true);
+    if (m == -1) {
+        Wander();
+        return 1 << movebuttons[bot.wanderdir];
+    }
+
+    nx = pl->x + movedx[m];
+    ny = pl->y + movedy[m];
+    if (map.foreground[ny][nx].flags & OF_BREAKABLE)
+    {
+        if (player.current_weapon != WEAPON_SWORD)
+            P_SwitchWeapon(WEAPON_SWORD);
+        return Attack(Direction(movedx[m], movedy[m]));
+    }
+
+    return 1 << movebuttons[m];
+}
+
+
+
+#pragma mark - Sessions
+
+//
+//  Bot_Play
+//  Play level from the start with seed until the bot exits, dies or
+//  maxticks go by
+//
+void Bot_Play (const map_t *level, uint64_t seed, int maxticks, botresult_t *result)
+{
+    extern char deathmsg[];
+    uint64_t    start, cost, total;
+    uint32_t    buttons;
+    memstats_t  heap;
+    size_t      live;
+    double      us;
+    int         count;
+
+    memset(result, 0, sizeof(*result));
+    Mem_GetTotal(&heap);
+    live = heap.live;
+    map = *level;
+    deathmsg[0] = '\0';
+    SeedRandom((unsigned)seed);
+    InitPlayer();
+    InitializeObjectList();
+    Bot_Start(seed);
+    tics = 0;
+    state = STATE_PLAY;
+
+    total = 0;
+    while (state == STATE_PLAY && tics < maxticks)
+    {
+        buttons = Bot_Think();
+        Input_SetButtons(buttons);
+
+        start = SDL_GetPerformanceCounter();
+        RunTick();
+        cost = SDL_GetPerformanceCounter() - start;
+
+        total += cost;
+        us = cost * 1e6 / SDL_GetPerformanceFrequency();
+        if (us > result->maxtickus)
+            result->maxtickus = us;
+        count = List_Count();
+        if (count > result->maxentities)
+            result->maxentities = count;
+    }
+
+    if (state == STATE_GAMEOVER) {
+        result->outcome = BOT_DIED;
+        strncpy(result->cause, deathmsg[0] ? deathmsg : "unknown", BOT_CAUSE_LEN - 1);
+    } else if (state == STATE_PLAY) {
+        result->outcome = BOT_TIMEOUT;
+    } else {
+        result->outcome = BOT_EXITED;
+    }
+    result->ticks = tics;
+    result->hp = player.obj->hp;
+    result->tickus = tics ? total * 1e6 / SDL_GetPerformanceFrequency() / tics : 0;
+
+    List_RemoveAll();
+    Mem_GetTotal(&heap);
+    result->heapkept = (long)heap.live - (long)live;
+}
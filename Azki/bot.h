@@ -0,0 +1,42 @@
+//
+//  bot.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef bot_h
+#define bot_h
+
+#include <stdint.h>
+#include "map.h"
+
+#define BOT_TICKS       (60 * 60 * 5)   // default give up after, 5 min of play
+#define BOT_CAUSE_LEN   40
+
+typedef enum
+{
+    BOT_CRASHED,    // never finished, e.g. the session's process died
+    BOT_EXITED,
+    BOT_DIED,
+    BOT_TIMEOUT
+} botoutcome_t;
+
+typedef struct
+{
+    botoutcome_t    outcome;
+    int             ticks;
+    int             hp;
+    int             maxentities;
+    long            heapkept;               // live heap bytes gained, a leak if not 0
+    char            cause[BOT_CAUSE_LEN];   // death message
+    double          tickus;                 // mean RunTick cost
+    double          maxtickus;
+} botresult_t;
+
+void        Bot_Start (uint64_t seed);
+uint32_t    Bot_Think (void);
+void        Bot_Play (const map_t *level, uint64_t seed, int maxticks, botresult_t *result);
+
+#endif /* bot_h */
@@ -5,13 +5,19 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "cmdlib.h"
+#include "rng.h"
 
-#define CMWC_CYCLE 4096
-#define CMWC_C_MAX 809430660
+#define EFFECT_DRAWS    256     // RandomEffect numbers made at a time
 
-static uint32_t Q[CMWC_CYCLE];
-static uint32_t c;
-static unsigned ri;
+// the game's random numbers, all part of the play state
+static struct
+{
+    uint64_t    seed;                   // keys the per-entity counters
+    rng_t       stream;                 // Random
+    rngbatch_t  effects;                // RandomEffect, filled in bulk
+    uint32_t    effectbuf[EFFECT_DRAWS];
+    int         effectnext;
+} rng;
 
 int     myargc;
 char ** myargv;
@@ -72,44 +78,66 @@ void filebasename (char *path, char *dest, size_t size)
     }
 }
 
-// make 32-bit Randomom number
-static uint32_t rand32 (void)
+// standard (zlib) CRC-32, bitwise: only used on whole files
+uint32_t CRC32 (const void *data, size_t length)
 {
-    uint32_t result;
+    const byte *p;
+    uint32_t crc;
+    int k;
     
-    result = rand();
-    return result << 16 | rand();
+    p = data;
+    crc = 0xFFFFFFFF;
+    while (length--)
+    {
+        crc ^= *p++;
+        for (k=0 ; k<8 ; k++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
 }
 
-// init the state with seed
+// init the streams with seed
 void SeedRandom (unsigned int seed)
 {
-    int i;
-    
-    srand(seed);
-    for (i = 0; i < CMWC_CYCLE; i++)
-        Q[i] = rand32();
+    rng_t effects;
     
-    do
-        c = rand32();
-    while (c >= CMWC_C_MAX);
-    ri = CMWC_CYCLE - 1;
+    rng.seed = seed;
+    Rng_Seed(&rng.stream, seed);
+    Rng_Split(&rng.stream, &effects);
+    Rng_InitBatch(&rng.effects, &effects);
+    rng.effectnext = EFFECT_DRAWS;
 }
 
+// the generators' state as one block, for world snapshots
+void *RandomState (size_t *size)
+{
+    *size = sizeof(rng);
+    return &rng;
+}
+
+
 uint32_t Random (void)
 {
-    uint64_t const a = 18782;
-    uint32_t const m = 0xfffffffe;
-    uint64_t t;
-    uint32_t x;
-
-    ri = (ri + 1) & (CMWC_CYCLE - 1);
-    t = a * Q[ri] + c;
-    c = t >> 32;
-    x = (uint32_t)(t + c);
-    if (x < c) {
-        x++;
-        c++;
+    return Rng_Next(&rng.stream);
+}
+
+
+uint64_t RandomSeed (void)
+{
+    return rng.seed;
+}
+
+
+//
+//  RandomEffect
+//  For things that only change how the map looks, like water: a stream
+//  of its own, so they don't change what Random gives everything else
+//
+uint32_t RandomEffect (void)
+{
+    if (rng.effectnext == EFFECT_DRAWS) {
+        Rng_Fill(&rng.effects, rng.effectbuf, EFFECT_DRAWS);
+        rng.effectnext = 0;
     }
-    return Q[ri] = m - x;
+    return rng.effectbuf[rng.effectnext++];
 }
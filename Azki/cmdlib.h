@@ -25,7 +25,12 @@ char *strupper (char *start);   // capitalize a string
 //  "/path/to/filename.ext" becomes "filename"
 void filebasename (char *path, char *dest, size_t size);
 
+uint32_t CRC32 (const void *data, size_t length);
+
 void SeedRandom (unsigned int seed);
 uint32_t Random (void);
+uint32_t RandomEffect (void);
+uint64_t RandomSeed (void);
+void *RandomState (size_t *size);
 
 #endif /* cmdlib_h */
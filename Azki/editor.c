@@ -7,12 +7,26 @@
 //
 
 #include <SDL2/SDL.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "azki.h"
 #include "video.h"
 #include "obj.h"
 #include "map.h"
+#include "mapcodec.h"
+#include "journal.h"
+#include "watch.h"
+#include "mapindex.h"
+#include "undo.h"
+#include "cmdlib.h"
+#include "rng.h"
+#include "log.h"
+
+#define SEARCH_LEN      40
+#define SEARCH_ROWS     12      // results shown at once
+#define MAX_RESULTS     1024
+#define HIGHLIGHT_MS    4000    // how long found tiles blink after a jump
 
 typedef enum {
     LAYER_FG,
@@ -36,10 +50,64 @@ static char lowermsg[100];
 static layerview_t activelayer;
 static layerview_t viewlayer;
 
+// object search
+static struct
+{
+    bool            open;
+    bool            changed;    // text changed since the last query
+    char            text[SEARCH_LEN + 1];
+    char            status[MAP_W + 1];
+    indexmatch_t    results[MAX_RESULTS];
+    int             numresults;
+    int             selected;
+} search;
+
+static indexmatch_t highlight;
+static Uint32       highlighttime;
+
+static bool         undoing;    // changes aren't recorded for undo
+static bool         selftest;   // or journaled
+
+typedef enum
+{
+    TOOL_DRAW,
+    TOOL_RECT,
+    TOOL_LINE,
+    TOOL_SELECT
+} tool_t;
+
+static tool_t       tool;
+static bool         dragging;   // the left button went down on the map with a drag tool
+static SDL_Point    anchor;     // where the drag started
+static SDL_Rect     selection;  // in tiles, w is 0 if there's none
+
+static struct
+{
+    int             w;
+    int             h;
+    objtype_t       types[2][MAP_H][MAP_W];
+} clipboard;
+
+// the map as edited, kept while a copy of it is played
+static struct
+{
+    bool            playing;
+    bool            dirty;
+    map_t           map;
+    byte            file[MAPFILE_MAX];  // what it was loaded from or saved as
+    size_t          filesize;
+} test;
+
 static char *layer_msg[] = {
     "(Editing Foreground)",
     "(Editing Background)"
 };
+static char *tool_msg[] = {
+    "Draw",
+    "Rect",
+    "Line",
+    "Select"
+};
 static char *show_msg[] = {
     "Showing: FG   ",
     "Showing:    BG",
@@ -52,16 +120,25 @@ control_t editorcontrols[] =
     { " ", " "},
     { "KEY", "ACTION" },
     { "--------", "--------" },
-    { "`", "Save and play level" },
+    { "`", "Play level, ` again to return" },
     { "+ and -", "Increase/Decrease window size" },
     { "[ and ]", "Save and previous/next level" },
     { "F1", "Show this screen!" },
     { "F2", "Show Character Viewer"},
     { "CTRL-S", "Save map" },
+    { "CTRL-Z", "Undo (with SHIFT: redo)" },
+    { "CTRL-Y", "Redo" },
+    { "/", "Find objects in all levels" },
     { "ESCAPE", "Save and Quit" },
     { "--------", "--------" },
     { "TAB", "Show Object Palette" },
     { "L MOUSE", "Place object" },
+    { "F+L MOUSE", "Fill area" },
+    { "1 2 3 4", "Draw, rect, line, select tool" },
+    { "CTRL-C", "Copy selection" },
+    { "CTRL-V", "Paste at mouse" },
+    { "DELETE", "Erase selection" },
+    { "CTRL-R", "Replace type under mouse" },
     { "R MOUSE", "\"Pick up\" object" },
     { "SPACE", "Switch layer" },
     { "F", "Show foreground layer only" },
@@ -135,33 +212,356 @@ void EditorSaveMap (void)
 
 
 
-void FloodFill (tile x, tile y, objtype_t oldtype, objtype_t newtype)
+//
+//  SetTileRun
+//  Set tiles x1...x2 of row y. All map changes in the editor go through
+//  here, so they're journaled and can be undone.
+//
+static void SetTileRun (layerview_t layer, tile x1, tile x2, tile y, objtype_t type)
+{
+    obj_t *row;
+    obj_t obj;
+    tile x;
+    
+    row = layer == LAYER_FG ? map.foreground[y] : map.background[y];
+    obj = NewObjectFromDef(type, x1, y);
+    for (x=x1 ; x<=x2 ; x++)
+    {
+        if (row[x].type == type)
+            continue;
+        
+        if (!undoing)
+            Undo_Record(map.num, layer, x, y, row[x].type, type);
+        if (!selftest)
+            Journal_Edit(map.num, layer, x, y, type);
+        obj.x = x;
+        row[x] = obj;
+        mapdirty = true;
+    }
+}
+
+
+void EditorSetTile (layerview_t layer, tile x, tile y, objtype_t type)
+{
+    SetTileRun(layer, x, x, y, type);
+}
+
+
+//
+//  EditorUndo
+//  Revert the last stroke, or with redo, apply the last one undone
+//
+void EditorUndo (bool redo)
+{
+    const undodelta_t *delta;
+    int i, count;
+    
+    delta = redo ? Undo_Redo(map.num, &count) : Undo_Undo(map.num, &count);
+    if (!delta) {
+        strcpy(lowermsg, redo ? "Nothing to redo" : "Nothing to undo");
+        return;
+    }
+    
+    undoing = true;
+    if (redo) {
+        for (i=0 ; i<count ; i++, delta++)
+            EditorSetTile(UNDO_LAYER(delta), UNDO_X(delta), UNDO_Y(delta), delta->newtype);
+    } else {
+        for (i=count-1, delta+=count-1 ; i>=0 ; i--, delta--)
+            EditorSetTile(UNDO_LAYER(delta), UNDO_X(delta), UNDO_Y(delta), delta->oldtype);
+    }
+    undoing = false;
+    
+    sprintf(lowermsg, "%s %d tile%s", redo ? "Redid" : "Undid", count, count == 1 ? "" : "s");
+}
+
+
+//
+//  FloodFill
+//  Fill the area of same-type tiles around x, y on the active layer a
+//  row at a time. The stack holds the starts of spans still to be looked
+//  at; a filled span pushes at most one per cell in the rows above and
+//  below it.
+//
+void FloodFill (tile x, tile y, objtype_t newtype)
 {
+    static uint16_t stack[MAP_W * MAP_H * 2];
+    obj_t           (*layer)[MAP_W];
+    objtype_t       oldtype;
+    int             top, left, right, ny, i;
+    
+    layer = activelayer == LAYER_FG ? map.foreground : map.background;
+    oldtype = layer[y][x].type;
     if (oldtype == newtype)
         return;
     
-    if (x < 0 || x >= MAP_W || y < 0 || y >= MAP_H)
+    top = 0;
+    stack[top++] = y * MAP_W + x;
+    while (top)
+    {
+        top--;
+        x = stack[top] % MAP_W;
+        y = stack[top] / MAP_W;
+        if (layer[y][x].type != oldtype)
+            continue; // filled since it was pushed
+        
+        for (left=x ; left>0 && layer[y][left - 1].type == oldtype ; left--)
+            ;
+        for (right=x ; right<MAP_W-1 && layer[y][right + 1].type == oldtype ; right++)
+            ;
+        SetTileRun(activelayer, left, right, y, newtype);
+        
+        for (ny=y-1 ; ny<=y+1 ; ny+=2)
+        {
+            if (ny < 0 || ny >= MAP_H)
+                continue;
+            for (i=left ; i<=right ; i++)
+                if (layer[ny][i].type == oldtype && (i == left || layer[ny][i - 1].type != oldtype))
+                    stack[top++] = ny * MAP_W + i;
+        }
+    }
+}
+
+
+
+#pragma mark - Tools
+
+// the rectangle of tiles between corners a and b
+static SDL_Rect TileRect (SDL_Point a, SDL_Point b)
+{
+    SDL_Rect r;
+    
+    r.x = a.x < b.x ? a.x : b.x;
+    r.y = a.y < b.y ? a.y : b.y;
+    r.w = abs(b.x - a.x) + 1;
+    r.h = abs(b.y - a.y) + 1;
+    return r;
+}
+
+
+static void FillTiles (SDL_Rect r, objtype_t type)
+{
+    tile y;
+    
+    for (y=r.y ; y<r.y+r.h ; y++)
+        SetTileRun(activelayer, r.x, r.x + r.w - 1, y, type);
+}
+
+
+//
+//  LineTiles
+//  Call func for each tile on the line from a to b (Bresenham)
+//
+static void LineTiles (SDL_Point a, SDL_Point b, void (* func)(tile x, tile y))
+{
+    int dx, dy, sx, sy, err, e2;
+    
+    dx = abs(b.x - a.x);
+    dy = -abs(b.y - a.y);
+    sx = a.x < b.x ? 1 : -1;
+    sy = a.y < b.y ? 1 : -1;
+    err = dx + dy;
+    while (1)
+    {
+        func(a.x, a.y);
+        if (a.x == b.x && a.y == b.y)
+            break;
+        e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            a.x += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            a.y += sy;
+        }
+    }
+}
+
+
+static void PlotTile (tile x, tile y)
+{
+    EditorSetTile(activelayer, x, y, cursor);
+}
+
+
+static void PreviewTile (tile x, tile y)
+{
+    DrawGlyph(&objdefs[cursor].glyph, x * TILE_SIZE, y * TILE_SIZE, TRANSP);
+}
+
+
+//
+//  ReplaceAll
+//  Change every oldtype tile on the active layer to newtype, in the
+//  selection if there is one
+//
+static int ReplaceAll (objtype_t oldtype, objtype_t newtype)
+{
+    SDL_Rect    r;
+    obj_t *     row;
+    tile        x, y, run;
+    int         count;
+    
+    if (oldtype == newtype)
+        return 0;
+    
+    r = selection.w ? selection : (SDL_Rect){ 0, 0, MAP_W, MAP_H };
+    count = 0;
+    for (y=r.y ; y<r.y+r.h ; y++)
+    {
+        row = activelayer == LAYER_FG ? map.foreground[y] : map.background[y];
+        for (x=r.x ; x<r.x+r.w ; x=run)
+        {
+            for (run=x ; run<r.x+r.w && row[run].type == oldtype ; run++)
+                ;
+            if (run > x) {
+                SetTileRun(activelayer, x, run - 1, y, newtype);
+                count += run - x;
+            } else {
+                run++;
+            }
+        }
+    }
+    
+    return count;
+}
+
+
+//
+//  CopySelection
+//  Copy both layers in the selection
+//
+static void CopySelection (void)
+{
+    int layer, y, x;
+    obj_t *row;
+    
+    if (!selection.w) {
+        strcpy(lowermsg, "Nothing selected");
         return;
+    }
     
-    switch (activelayer) {
-        case LAYER_FG:
-            if (map.foreground[y][x].type != oldtype)
-                return;
-            map.foreground[y][x] = NewObjectFromDef(newtype, x, y);
+    clipboard.w = selection.w;
+    clipboard.h = selection.h;
+    for (layer=0 ; layer<2 ; layer++)
+    {
+        for (y=0 ; y<selection.h ; y++)
+        {
+            row = layer == LAYER_FG
+                ? &map.foreground[selection.y + y][selection.x]
+                : &map.background[selection.y + y][selection.x];
+            for (x=0 ; x<selection.w ; x++)
+                clipboard.types[layer][y][x] = row[x].type;
+        }
+    }
+    sprintf(lowermsg, "Copied %d x %d", clipboard.w, clipboard.h);
+}
+
+
+//
+//  Paste
+//  Put the clipboard's layers down with the top left at x, y, clipped to
+//  the map. Rows are set a run of one type at a time.
+//
+static void Paste (tile x, tile y)
+{
+    const objtype_t *types;
+    int layer, row, w, h, i, run;
+    
+    if (!clipboard.w) {
+        strcpy(lowermsg, "Nothing to paste");
+        return;
+    }
+    
+    w = x + clipboard.w > MAP_W ? MAP_W - x : clipboard.w;
+    h = y + clipboard.h > MAP_H ? MAP_H - y : clipboard.h;
+    for (layer=0 ; layer<2 ; layer++)
+    {
+        for (row=0 ; row<h ; row++)
+        {
+            types = clipboard.types[layer][row];
+            for (i=0 ; i<w ; i=run)
+            {
+                for (run=i+1 ; run<w && types[run] == types[i] ; run++)
+                    ;
+                SetTileRun(layer, x + i, x + run - 1, y + row, types[i]);
+            }
+        }
+    }
+    sprintf(lowermsg, "Pasted %d x %d", w, h);
+}
+
+
+//
+//  EditorMouseUp
+//  The left button was let go after a drag that started on the map
+//
+static void EditorMouseUp (SDL_Point *end)
+{
+    switch (tool)
+    {
+        case TOOL_RECT:
+            FillTiles(TileRect(anchor, *end), cursor);
             break;
-        case LAYER_BG:
-            if (map.background[y][x].type != oldtype)
-                return;
-            map.background[y][x] = NewObjectFromDef(newtype, x, y);
+        case TOOL_LINE:
+            LineTiles(anchor, *end, PlotTile);
+            break;
+        case TOOL_SELECT:
+            if (anchor.x == end->x && anchor.y == end->y)
+                selection.w = selection.h = 0; // a click clears it
+            else
+                selection = TileRect(anchor, *end);
             break;
         default:
             break;
     }
+}
+
+
+//
+//  DrawTool
+//  The selection, and what a drag will do
+//
+static void DrawTool (SDL_Point *mousetile)
+{
+    SDL_Rect r;
+    
+    SDL_RenderSetViewport(renderer, &maprect);
+    if (selection.w)
+    {
+        r = (SDL_Rect){
+            selection.x * TILE_SIZE - 1,
+            selection.y * TILE_SIZE - 1,
+            selection.w * TILE_SIZE + 2,
+            selection.h * TILE_SIZE + 2
+        };
+        SetPaletteColor(BRIGHTCYAN);
+        SDL_RenderDrawRect(renderer, &r);
+    }
     
-    FloodFill(x, y + 1, oldtype, newtype);
-    FloodFill(x, y - 1, oldtype, newtype);
-    FloodFill(x - 1, y, oldtype, newtype);
-    FloodFill(x + 1, y, oldtype, newtype);
+    if (dragging)
+    {
+        switch (tool)
+        {
+            case TOOL_RECT:
+            case TOOL_SELECT:
+                r = TileRect(anchor, *mousetile);
+                r.x *= TILE_SIZE;
+                r.y *= TILE_SIZE;
+                r.w *= TILE_SIZE;
+                r.h *= TILE_SIZE;
+                SetPaletteColor(tool == TOOL_RECT ? RED : BRIGHTCYAN);
+                SDL_RenderDrawRect(renderer, &r);
+                break;
+            case TOOL_LINE:
+                LineTiles(anchor, *mousetile, PreviewTile);
+                break;
+            default:
+                break;
+        }
+    }
+    SDL_RenderSetViewport(renderer, NULL);
 }
 
 
@@ -312,9 +712,10 @@ void DrawEditorHUD (SDL_Point *mousept, SDL_Point *mousetile)
     
     // print mouse map coordinates
     if (SDL_PointInRect(mousept, &maprect))
-        sprintf(mouseinfo, "%s (%2d, %2d)", show_msg[viewlayer], mousetile->x, mousetile->y);
+        sprintf(mouseinfo, "%s %-6s (%2d, %2d)", show_msg[viewlayer], tool_msg[tool],
+                mousetile->x, mousetile->y);
     else
-        sprintf(mouseinfo, "%s (--, --)", show_msg[viewlayer]);
+        sprintf(mouseinfo, "%s %-6s (--, --)", show_msg[viewlayer], tool_msg[tool]);
     LOG(mouseinfo, BRIGHTWHITE);
 }
 
@@ -344,11 +745,295 @@ void EditorDrawMap (map_t *map)
 
 
 
+#pragma mark - Search
+
+static void OpenSearch (void)
+{
+    search.open = true;
+    search.changed = true;
+    Index_Refresh(); // pick up levels changed outside the editor
+    snprintf(search.status, sizeof(search.status),
+             "%d levels. Name objects, e.g. spider, key, -door", Index_NumMaps());
+}
+
+
+static void RunSearch (void)
+{
+    const char *error;
+    Uint64 start;
+    double ms;
+
+    start = SDL_GetPerformanceCounter();
+    search.numresults = Index_Query(search.text, search.results, MAX_RESULTS, &error);
+    ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    search.selected = 0;
+    search.changed = false;
+    if (search.numresults < 0) {
+        search.numresults = 0;
+        snprintf(search.status, sizeof(search.status), "%s", error);
+    } else {
+        snprintf(search.status, sizeof(search.status), "%d%s levels (%.2f ms)",
+                 search.numresults, search.numresults == MAX_RESULTS ? "+" : "", ms);
+    }
+}
+
+
+//
+//  JumpToResult
+//  Go to the selected level and show where the objects are
+//
+static void JumpToResult (void)
+{
+    const indexmatch_t *result;
+
+    if (!search.numresults)
+        return;
+    result = &search.results[search.selected];
+
+    if (result->mapnum != map.num)
+    {
+        if (mapdirty && !SaveMap(&map)) {
+            sprintf(lowermsg, "Couldn't save level %d!", map.num);
+            return;
+        }
+        // DecodeMap leaves the map as it was if the level is damaged
+        if (!LoadMap(result->mapnum, &map)) {
+            sprintf(lowermsg, "Couldn't load level %d!", result->mapnum);
+            return;
+        }
+        mapdirty = false;
+    }
+
+    highlight = *result;
+    highlighttime = SDL_GetTicks();
+    if (result->numtiles)
+        activelayer = INDEX_LAYER(result->tiles[0]) ? LAYER_BG : LAYER_FG;
+    search.open = false;
+    sprintf(lowermsg, "Found %d in level %d", result->count, result->mapnum);
+}
+
+
+static void SearchKeyDown (SDL_Keycode key)
+{
+    size_t len;
+
+    len = strlen(search.text);
+    switch (key)
+    {
+        case SDLK_ESCAPE:
+            search.open = false;
+            break;
+
+        case SDLK_RETURN:
+        case SDLK_KP_ENTER:
+            if (search.changed)
+                RunSearch();
+            else
+                JumpToResult();
+            break;
+
+        case SDLK_UP:
+            if (search.selected > 0)
+                search.selected--;
+            break;
+        case SDLK_DOWN:
+            if (search.selected < search.numresults - 1)
+                search.selected++;
+            break;
+
+        case SDLK_BACKSPACE:
+            if (len) {
+                search.text[len - 1] = '\0';
+                search.changed = true;
+            }
+            break;
+
+        default:
+            if (key >= ' ' && key < 127 && len < SEARCH_LEN) {
+                search.text[len] = key;
+                search.text[len + 1] = '\0';
+                search.changed = true;
+            }
+            break;
+    }
+}
+
+
+static void DrawSearch (void)
+{
+    const indexmatch_t *result;
+    const char *name;
+    char line[MAP_W + 1];
+    int i, first, rows;
+
+    rows = search.numresults < SEARCH_ROWS ? search.numresults : SEARCH_ROWS;
+    SDL_SetRenderDrawColor(renderer, 14, 14, 14, 255);
+    FillRect(maprect.x, maprect.y, maprect.w, (rows + 2) * TILE_SIZE);
+
+    snprintf(line, sizeof(line), "FIND: %s%c", search.text,
+             SDL_GetTicks() % 600 < 300 ? '_' : ' ');
+    TextColor(BRIGHTGREEN);
+    PrintString(line, maprect.x, maprect.y);
+    TextColor(GRAY);
+    PrintString(search.status, maprect.x, maprect.y + TILE_SIZE);
+
+    // keep the selection in view
+    first = clamp(search.selected - rows / 2, 0, search.numresults - rows);
+    for (i=0 ; i<rows ; i++)
+    {
+        result = &search.results[first + i];
+        name = MapName(result->mapnum);
+        snprintf(line, sizeof(line), "%4d  %-36.36s %5d",
+                 result->mapnum, name ? name : "", result->count);
+        TextColor(first + i == search.selected ? YELLOW : WHITE);
+        PrintString(line, maprect.x, maprect.y + (i + 2) * TILE_SIZE);
+    }
+}
+
+
+//
+//  DrawHighlight
+//  Blink boxes around the objects found, for a while after a jump
+//
+static void DrawHighlight (void)
+{
+    SDL_Rect box;
+    int i;
+
+    if (highlight.mapnum != map.num || SDL_GetTicks() - highlighttime > HIGHLIGHT_MS)
+        return;
+    if (SDL_GetTicks() % 600 >= 300)
+        return;
+
+    SDL_RenderSetViewport(renderer, &maprect);
+    SetPaletteColor(BRIGHTMAGENTA);
+    for (i=0 ; i<highlight.numtiles ; i++)
+    {
+        box.x = INDEX_X(highlight.tiles[i]) * TILE_SIZE - 2;
+        box.y = INDEX_Y(highlight.tiles[i]) * TILE_SIZE - 2;
+        box.w = box.h = TILE_SIZE + 4;
+        SDL_RenderDrawRect(renderer, &box);
+    }
+    SDL_RenderSetViewport(renderer, NULL);
+}
+
+
+
+#pragma mark - Testing
+
+//
+//  PlayTest
+//  Play the map from the editor. Play changes the map, so the editor's
+//  is kept aside and put back by EditorLoop, rather than saved and
+//  loaded again. Unsaved edits are only in memory and the journal.
+//
+static void PlayTest (void)
+{
+    const byte *file;
+    
+    memcpy(&test.map, &map, sizeof(test.map));
+    test.dirty = mapdirty;
+    file = LoadedMapFile(&test.filesize);
+    if (file)
+        memcpy(test.file, file, test.filesize);
+    else
+        test.filesize = 0;
+    
+    test.playing = true;
+    state = STATE_PLAY;
+}
+
+
+//
+//  EndPlayTest
+//  Back from playing, put the edited map back
+//
+static void EndPlayTest (void)
+{
+    memcpy(&map, &test.map, sizeof(map));
+    mapdirty = test.dirty;
+    if (test.filesize)
+        SetLoadedMapFile(test.file, test.filesize);
+    
+    test.playing = false;
+}
+
+
+//
+//  EditorTestMap
+//  Restarting a level played from the editor: the edited map, not the
+//  one on disk, which lacks unsaved edits. False if not testing.
+//
+bool EditorTestMap (map_t *out)
+{
+    if (!test.playing)
+        return false;
+    
+    memcpy(out, &test.map, sizeof(*out));
+    if (test.filesize)
+        SetLoadedMapFile(test.file, test.filesize);
+    return true;
+}
+
+
+//
+//  EditorReloaded
+//  Level changed on disk from old (NULL if unknown) to new. The edited
+//  map kept aside while testing needs the change too, or EndPlayTest
+//  would put back the stale one and the next save overwrite the file.
+//
+void EditorReloaded (const map_t *old, const map_t *new, const byte *data, size_t size)
+{
+    const obj_t *o, *n;
+    obj_t *kept;
+    int layer, i;
+    
+    if (!test.playing || test.map.num != new->num)
+        return;
+    
+    if (!old) {
+        memcpy(&test.map, new, sizeof(test.map));
+    } else {
+        for (layer=0 ; layer<2 ; layer++)
+        {
+            kept = layer ? &test.map.background[0][0] : &test.map.foreground[0][0];
+            o = layer ? &old->background[0][0] : &old->foreground[0][0];
+            n = layer ? &new->background[0][0] : &new->foreground[0][0];
+            for (i=0 ; i<MAP_W*MAP_H ; i++, kept++, o++, n++)
+                if (memcmp(o, n, sizeof(obj_t)))
+                    *kept = *n;
+        }
+    }
+    
+    memcpy(test.file, data, size);
+    test.filesize = size;
+    Undo_Clear(); // the history is of tiles that may have changed
+}
+
+
+//
+//  EditorShutdown
+//  Quitting: a map being played from the editor may have unsaved edits
+//
+void EditorShutdown (void)
+{
+    if (test.playing && test.dirty)
+        SaveMap(&test.map);
+}
+
+
+
 #pragma mark - Input
 
-void EditorKeyDown (SDL_Keycode key)
+void EditorKeyDown (SDL_Keycode key, SDL_Point *mousetile)
 {
+    bool onmap;
+    int count;
+    
     memset(lowermsg, 0, sizeof(lowermsg)); // clear the LOG message
+    onmap = mousetile->x >= 0 && mousetile->x < MAP_W
+        && mousetile->y >= 0 && mousetile->y < MAP_H;
     
     switch (key)
     {
@@ -399,10 +1084,50 @@ void EditorKeyDown (SDL_Keycode key)
                 EditorSaveMap();
             break;
             
+        // tools
+        case SDLK_1:
+        case SDLK_2:
+        case SDLK_3:
+        case SDLK_4:
+            tool = key - SDLK_1;
+            dragging = false;
+            break;
+            
+        // selection
+        case SDLK_c:
+            if (CTRL)
+                CopySelection();
+            break;
+        case SDLK_v:
+            if (CTRL && onmap)
+                Paste(mousetile->x, mousetile->y);
+            break;
+        case SDLK_DELETE:
+            if (selection.w)
+                FillTiles(selection, TYPE_NONE);
+            break;
+            
+        // replace all of the type under the mouse
+        case SDLK_r:
+            if (CTRL && onmap) {
+                count = ReplaceAll(ObjectAtMapTile(mousetile)->type, cursor);
+                sprintf(lowermsg, "Replaced %d", count);
+            }
+            break;
+            
+        // undo and redo
+        case SDLK_z:
+            if (CTRL)
+                EditorUndo(SHIFT);
+            break;
+        case SDLK_y:
+            if (CTRL)
+                EditorUndo(true);
+            break;
+            
         // switch to play
         case SDLK_BACKQUOTE:
-            SaveMap(&map);
-            state = STATE_PLAY;
+            PlayTest();
             break;
             
         case SDLK_F1:
@@ -413,6 +1138,10 @@ void EditorKeyDown (SDL_Keycode key)
             S_CharacterViewer();
             break;
             
+        case SDLK_SLASH:
+            OpenSearch();
+            break;
+            
         default:
             break;
     }
@@ -423,23 +1152,24 @@ void EditorKeyDown (SDL_Keycode key)
 
 void EditorMouseDown (SDL_Point * mousept, SDL_Point * mousetile)
 {
-    obj_t *obj;
-    
     // place an object on map if editing
     if (!grid.shown && SDL_PointInRect(mousept, &maprect))
     {
-        obj = ObjectAtMapTile(mousetile);
-        if (keys[SDL_SCANCODE_F]) {
-            FloodFill(mousetile->x, mousetile->y, obj->type, cursor);
+        if (tool != TOOL_DRAW) {
+            if (!dragging) {
+                dragging = true;
+                anchor = *mousetile;
+            }
+        }
+        else if (keys[SDL_SCANCODE_F]) {
+            FloodFill(mousetile->x, mousetile->y, cursor);
         }
 //        else if (keys[SDL_SCANCODE_D]) {
 //            cursor = obj->type;
 //        }
         else {
-            *obj = NewObjectFromDef(cursor, mousetile->x, mousetile->y);
+            EditorSetTile(activelayer, mousetile->x, mousetile->y, cursor);
         }
-        
-        mapdirty = true;
     }
     
     // select an object if grid is open
@@ -458,11 +1188,15 @@ void EditorLoop (void)
     uint32_t    mousestate;
     SDL_Point   mousept;
     SDL_Point   mousetile;
+    SDL_Point   droptile;
     
     memset(lowermsg, 0, sizeof(lowermsg));
     MakeSelectionGrid();
     activelayer = LAYER_FG;
-    LoadMap(map.num, &map); // entities were removed in play, reload
+    if (test.playing)
+        EndPlayTest();
+    else
+        LoadMap(map.num, &map); // entities were removed in play, reload
         
     while (state == STATE_EDIT)
     {
@@ -480,7 +1214,11 @@ void EditorLoop (void)
                     Quit(NULL);
                     break;
                 case SDL_KEYDOWN:
-                    EditorKeyDown(event.key.keysym.sym);
+                    if (search.open) {
+                        SearchKeyDown(event.key.keysym.sym);
+                        break;
+                    }
+                    EditorKeyDown(event.key.keysym.sym, &mousetile);
                     if (state == STATE_PLAY)
                         return;
                     break;
@@ -495,29 +1233,50 @@ void EditorLoop (void)
                         default:
                             break;
                     }
+                    break;
                 default:
+                    Watch_HandleEvent(&event);
                     break;
             }
         }
         
-        grid.shown = keys[SDL_SCANCODE_TAB];
+        // keys held while typing a search aren't commands
+        grid.shown = keys[SDL_SCANCODE_TAB] && !search.open;
         
-        if (keys[SDL_SCANCODE_F])
+        if (search.open)
+            viewlayer = LAYER_BOTH;
+        else if (keys[SDL_SCANCODE_F])
             viewlayer = LAYER_FG;
         else if (keys[SDL_SCANCODE_B])
             viewlayer = LAYER_BG;
         else
             viewlayer = LAYER_BOTH;
         
-        if (mousestate & SDL_BUTTON_LMASK)
+        // drags end where the mouse is, on the map or its edge
+        droptile.x = clamp(mousetile.x, 0, MAP_W - 1);
+        droptile.y = clamp(mousetile.y, 0, MAP_H - 1);
+        
+        if ((mousestate & SDL_BUTTON_LMASK) && !search.open) {
             EditorMouseDown(&mousept, &mousetile);
+        } else {
+            if (dragging) {
+                dragging = false;
+                EditorMouseUp(&droptile);
+            }
+            Undo_EndStroke(); // a stroke is everything until the button's let go
+        }
+        Journal_Flush();
         
         Clear(0, 0, 0);
         
         EditorDrawMap(&map);
         DrawEditorHUD(&mousept, &mousetile);
         
-        if ( SDL_PointInRect(&mousept, &maprect) )
+        DrawHighlight();
+        DrawTool(&droptile);
+        if ( search.open )
+            DrawSearch();
+        else if ( SDL_PointInRect(&mousept, &maprect) )
             DrawCursor(&mousetile);
         if ( grid.shown )
             DrawSelectionGrid(&mousept);
@@ -528,3 +1287,165 @@ void EditorLoop (void)
         LimitFrameRate(FRAME_RATE);
     }
 }
+
+
+
+#pragma mark - Self-test
+
+#define TEST_FILLS      200
+#define TEST_UNDO_CELLS 1500    // at least this many cells in one undone stroke
+
+static bool Check (bool ok, const char *name)
+{
+    if (ok)
+        LogInfo("EditorSelfTest: %s ok", name);
+    else
+        LogError("EditorSelfTest: %s FAILED", name);
+    return ok;
+}
+
+
+static void ForegroundTypes (objtype_t types[MAP_H][MAP_W])
+{
+    int x, y;
+    
+    for (y=0 ; y<MAP_H ; y++)
+        for (x=0 ; x<MAP_W ; x++)
+            types[y][x] = map.foreground[y][x].type;
+}
+
+
+// set the whole foreground without the editor's history
+static void SetForeground (rng_t *rng, int percent, objtype_t type)
+{
+    int x, y;
+    
+    for (y=0 ; y<MAP_H ; y++)
+        for (x=0 ; x<MAP_W ; x++)
+            map.foreground[y][x] = NewObjectFromDef(Rng_Range(rng, 100) < percent
+                                                    ? type : TYPE_NONE, x, y);
+}
+
+
+//
+//  ReferenceFill
+//  Fill a cell at a time, the plain way, to check FloodFill against
+//
+static void ReferenceFill (objtype_t types[MAP_H][MAP_W], tile x, tile y, objtype_t newtype)
+{
+    static uint16_t stack[MAP_W * MAP_H * 4 + 1];
+    objtype_t       oldtype;
+    int             top, cell;
+    
+    oldtype = types[y][x];
+    if (oldtype == newtype)
+        return;
+    
+    top = 0;
+    stack[top++] = y * MAP_W + x;
+    while (top)
+    {
+        cell = stack[--top];
+        x = cell % MAP_W;
+        y = cell / MAP_W;
+        if (types[y][x] != oldtype)
+            continue;
+        
+        types[y][x] = newtype;
+        if (x > 0)
+            stack[top++] = cell - 1;
+        if (x < MAP_W - 1)
+            stack[top++] = cell + 1;
+        if (y > 0)
+            stack[top++] = cell - MAP_W;
+        if (y < MAP_H - 1)
+            stack[top++] = cell + MAP_W;
+    }
+}
+
+
+//
+//  EditorSelfTest
+//  FloodFill against ReferenceFill on random maps, a whole map fill
+//  through undo and redo, and the play test copy, timed. Works on the
+//  current map and puts it back after. Backs the -edittest option.
+//
+bool EditorSelfTest (void)
+{
+    static map_t        saved;
+    static objtype_t    before[MAP_H][MAP_W];
+    static objtype_t    expect[MAP_H][MAP_W];
+    static objtype_t    got[MAP_H][MAP_W];
+    rng_t               rng;
+    layerview_t         savedlayer;
+    Uint64              start;
+    double              copyms, restorems;
+    bool                saveddirty, ok, all;
+    int                 savedstate, i, x, y, count;
+    
+    memcpy(&saved, &map, sizeof(saved));
+    saveddirty = mapdirty;
+    savedlayer = activelayer;
+    savedstate = state;
+    selftest = true;
+    activelayer = LAYER_FG;
+    Undo_Clear();
+    Rng_Seed(&rng, 1);
+    all = true;
+    
+    // scanline fill against the plain one, on random walls
+    ok = true;
+    for (i=0 ; i<TEST_FILLS && ok ; i++)
+    {
+        SetForeground(&rng, 20 + i % 50, TYPE_ROCK1);
+        x = Rng_Range(&rng, MAP_W);
+        y = Rng_Range(&rng, MAP_H);
+        ForegroundTypes(expect);
+        ReferenceFill(expect, x, y, TYPE_WATER);
+        FloodFill(x, y, TYPE_WATER);
+        Undo_EndStroke();
+        ForegroundTypes(got);
+        ok = !memcmp(got, expect, sizeof(got));
+    }
+    all &= Check(ok, "flood fill matches reference fill");
+    
+    // one stroke over the whole map, undone and redone
+    Undo_Clear();
+    SetForeground(&rng, 0, TYPE_NONE);
+    ForegroundTypes(before);
+    FloodFill(0, 0, TYPE_GRASS1);
+    Undo_EndStroke();
+    ForegroundTypes(expect);
+    for (count=0, i=0 ; i<MAP_W*MAP_H ; i++)
+        count += (&before[0][0])[i] != (&expect[0][0])[i];
+    all &= Check(count >= TEST_UNDO_CELLS, "fill stroke size");
+    EditorUndo(false);
+    ForegroundTypes(got);
+    all &= Check(!memcmp(got, before, sizeof(got)), "undo fill");
+    EditorUndo(true);
+    ForegroundTypes(got);
+    all &= Check(!memcmp(got, expect, sizeof(got)), "redo fill");
+    
+    // the map kept aside while playing comes back as it was
+    memcpy(&map, &saved, sizeof(map));
+    start = SDL_GetPerformanceCounter();
+    PlayTest();
+    copyms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    map.foreground[0][0] = NewObjectFromDef(TYPE_WATER, 0, 0);
+    map.num++;
+    start = SDL_GetPerformanceCounter();
+    EndPlayTest();
+    restorems = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    all &= Check(!memcmp(&map, &saved, sizeof(map)), "play test restore");
+    LogInfo("EditorSelfTest: %d cell fill, play copy %.3f ms, restore %.3f ms",
+            count, copyms, restorems);
+    
+    memcpy(&map, &saved, sizeof(map));
+    mapdirty = saveddirty;
+    activelayer = savedlayer;
+    state = savedstate;
+    selftest = false;
+    Undo_Clear();
+    
+    return all;
+}
@@ -0,0 +1,206 @@
+//
+//  image.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Draw glyphs and maps into an RGB buffer, for tools and thumbnails
+//  that run without a window. Glyphs come from the same font data and
+//  palette as the font table, and are drawn in the same steps as
+//  DrawGlyph: shadow, background, glyph shadow, glyph. Blinking colors
+//  are drawn in their steady phase and there's no lighting.
+
+#include <stdlib.h>
+#include <string.h>
+#include "image.h"
+#include "video.h"
+#include "mem.h"
+
+extern const unsigned char fontdata[];
+
+
+
+bool Image_Alloc (image_t *img, int w, int h)
+{
+    img->w = w;
+    img->h = h;
+    img->pixels = Mem_Alloc(MEM_VIDEO, (size_t)w * h * IMAGE_BPP);
+    return img->pixels != NULL;
+}
+
+
+void Image_Free (image_t *img)
+{
+    Mem_Free(img->pixels);
+    img->pixels = NULL;
+    img->w = img->h = 0;
+}
+
+
+static void PutPixel (image_t *img, int x, int y, const SDL_Color *c)
+{
+    byte *p;
+
+    if (x < 0 || y < 0 || x >= img->w || y >= img->h)
+        return;
+
+    p = img->pixels + ((size_t)y * img->w + x) * IMAGE_BPP;
+    p[0] = c->r;
+    p[1] = c->g;
+    p[2] = c->b;
+}
+
+
+static void FillTile (image_t *img, pixel x, pixel y, int color)
+{
+    const SDL_Color *c;
+    int i, j;
+
+    c = PaletteColor(color);
+    for (j=0 ; j<TILE_SIZE ; j++)
+        for (i=0 ; i<TILE_SIZE ; i++)
+            PutPixel(img, x + i, y + j, c);
+}
+
+
+// the set pixels of character chr, as in CreateFontTable
+static void DrawCharacter (image_t *img, int chr, pixel x, pixel y, int color)
+{
+    const SDL_Color *c;
+    const byte *data;
+    int i, j;
+
+    c = PaletteColor(color);
+    data = &fontdata[chr * TILE_SIZE];
+    for (j=0 ; j<TILE_SIZE ; j++, data++)
+        for (i=0 ; i<TILE_SIZE ; i++)
+            if (*data & (1 << (TILE_SIZE - 1 - i)))
+                PutPixel(img, x + i, y + j, c);
+}
+
+
+void Image_Fill (image_t *img, int color)
+{
+    const SDL_Color *c;
+    int x, y;
+
+    c = PaletteColor(color);
+    for (y=0 ; y<img->h ; y++)
+        for (x=0 ; x<img->w ; x++)
+            PutPixel(img, x, y, c);
+}
+
+
+//
+//  Image_DrawGlyph
+//  DrawGlyph into an image
+//
+void Image_DrawGlyph (image_t *img, const glyph_t *glyph, pixel x, pixel y, int shadow_color)
+{
+    int bg, fg;
+
+    bg = glyph->bg_color == TRANSP ? TRANSP : glyph->bg_color & ~BLINK;
+    fg = glyph->fg_color == TRANSP ? TRANSP : glyph->fg_color & ~BLINK;
+    if (glyph->character == CHAR_NUL && bg == TRANSP)
+        return;
+
+    if (shadow_color != TRANSP && bg != TRANSP)
+        FillTile(img, x + 1, y + 1, PITCHBLACK);
+
+    if (bg != TRANSP)
+        FillTile(img, x, y, bg);
+
+    if (shadow_color != TRANSP && bg == TRANSP)
+        DrawCharacter(img, glyph->character, x + 1, y + 1, shadow_color);
+
+    if (fg != TRANSP)
+        DrawCharacter(img, glyph->character, x, y, fg);
+}
+
+
+//
+//  Image_DrawMap
+//  Draw map as DrawMap would, into an image MAP_W x MAP_H tiles big
+//
+void Image_DrawMap (image_t *img, const map_t *map)
+{
+    const obj_t *fg;
+    const obj_t *bg;
+    int i;
+
+    Image_Fill(img, BLACK);
+
+    fg = &map->foreground[0][0];
+    bg = &map->background[0][0];
+    for (i=0 ; i<MAP_W*MAP_H ; i++, fg++, bg++)
+    {
+        if (bg->type != TYPE_NONE)
+            Image_DrawGlyph(img, &bg->glyph, bg->x * TILE_SIZE, bg->y * TILE_SIZE, PITCHBLACK);
+        if (fg->type != TYPE_NONE)
+            Image_DrawGlyph(img, &fg->glyph, fg->x * TILE_SIZE, fg->y * TILE_SIZE, PITCHBLACK);
+    }
+}
+
+
+//
+//  Image_Shrink
+//  Average factor x factor blocks of src into dst
+//
+bool Image_Shrink (const image_t *src, image_t *dst, int factor)
+{
+    const byte *    s;
+    byte *          d;
+    unsigned        sum[IMAGE_BPP];
+    int             x, y, i, j, k, area;
+
+    if (!Image_Alloc(dst, src->w / factor, src->h / factor))
+        return false;
+
+    area = factor * factor;
+    d = dst->pixels;
+    for (y=0 ; y<dst->h ; y++)
+    {
+        for (x=0 ; x<dst->w ; x++)
+        {
+            memset(sum, 0, sizeof(sum));
+            for (j=0 ; j<factor ; j++)
+            {
+                s = src->pixels + ((size_t)(y * factor + j) * src->w + x * factor) * IMAGE_BPP;
+                for (i=0 ; i<factor ; i++)
+                    for (k=0 ; k<IMAGE_BPP ; k++)
+                        sum[k] += *s++;
+            }
+            for (k=0 ; k<IMAGE_BPP ; k++)
+                *d++ = (sum[k] + area / 2) / area;
+        }
+    }
+
+    return true;
+}
+
+
+//
+//  Image_Enlarge
+//  Scale src up by factor into dst, keeping the pixels sharp
+//
+bool Image_Enlarge (const image_t *src, image_t *dst, int factor)
+{
+    const byte *    s;
+    byte *          d;
+    int             x, y, i;
+
+    if (!Image_Alloc(dst, src->w * factor, src->h * factor))
+        return false;
+
+    d = dst->pixels;
+    for (y=0 ; y<dst->h ; y++)
+    {
+        s = src->pixels + (size_t)(y / factor) * src->w * IMAGE_BPP;
+        for (x=0 ; x<src->w ; x++, s+=IMAGE_BPP)
+            for (i=0 ; i<factor ; i++, d+=IMAGE_BPP)
+                memcpy(d, s, IMAGE_BPP);
+    }
+
+    return true;
+}
@@ -0,0 +1,36 @@
+//
+//  image.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef image_h
+#define image_h
+
+#include <stdbool.h>
+#include "azki.h"
+#include "glyph.h"
+#include "map.h"
+#include "cmdlib.h"
+
+#define IMAGE_BPP       3       // 8-bit RGB
+
+// an offscreen RGB image, drawn without a window or renderer
+typedef struct
+{
+    int     w;
+    int     h;
+    byte *  pixels;
+} image_t;
+
+bool Image_Alloc (image_t *img, int w, int h);
+void Image_Free (image_t *img);
+void Image_Fill (image_t *img, int color);
+void Image_DrawGlyph (image_t *img, const glyph_t *glyph, pixel x, pixel y, int shadow_color);
+void Image_DrawMap (image_t *img, const map_t *map);
+bool Image_Shrink (const image_t *src, image_t *dst, int factor);
+bool Image_Enlarge (const image_t *src, image_t *dst, int factor);
+
+#endif /* image_h */
@@ -98,7 +98,7 @@ objdef_t objdefs[NUMTYPES] =
 
     {   // TYPE_WATER
         .glyph = { CHAR_NUL, BRIGHTBLUE, BLUE },
-        .flags = OF_SOLID,
+        .flags = OF_SOLID|OF_TRANSLUCENT,
         .maxhealth = 0,
         .name = "Water",
         .hud = "",
@@ -328,7 +328,7 @@ objdef_t objdefs[NUMTYPES] =
     },
     {// TYPE_CANDLE
         .glyph = { 161, YELLOW, TRANSP },
-        .flags = OF_SOLID,
+        .flags = OF_SOLID|OF_TRANSLUCENT,
         .maxhealth = 0,
         .name = "Candle",
         .hud = "",
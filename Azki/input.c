@@ -0,0 +1,291 @@
+//
+//  input.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Player input by tick. Key events are queued with their SDL timestamps
+//  as the event pump delivers them, and each tick takes everything queued
+//  since the last one, so a key pressed and released within one frame, or
+//  during a slow frame, still reaches the game for a tick. Reading the
+//  keyboard state once per frame would lose it.
+//
+//  With latency on, each press is followed from its event timestamp to
+//  the tick that took it and the present after that tick, and the
+//  percentiles are logged every LATENCY_SAMPLES presses and at the end
+//  of a level. The pump stays on the main thread, as SDL requires there,
+//  so the timestamps are what give the real time of each press.
+
+#include <stdlib.h>
+#include <string.h>
+#include "input.h"
+#include "log.h"
+
+typedef struct
+{
+    uint32_t    time;       // SDL event timestamp, ms
+    uint8_t     button;
+    bool        down;
+} inputevent_t;
+
+typedef struct
+{
+    uint32_t    time;       // the press
+    uint32_t    consumed;   // its tick started
+    uint32_t    presented;  // that tick's frame was presented
+    int         tick;
+} latency_t;
+
+static const struct { SDL_Scancode key; button_t button; } bindings[] =
+{
+    { SDL_SCANCODE_W,       BT_NORTH },
+    { SDL_SCANCODE_S,       BT_SOUTH },
+    { SDL_SCANCODE_X,       BT_SOUTH },
+    { SDL_SCANCODE_A,       BT_WEST },
+    { SDL_SCANCODE_D,       BT_EAST },
+    { SDL_SCANCODE_Q,       BT_NORTHWEST },
+    { SDL_SCANCODE_E,       BT_NORTHEAST },
+    { SDL_SCANCODE_Z,       BT_SOUTHWEST },
+    { SDL_SCANCODE_C,       BT_SOUTHEAST },
+    { SDL_SCANCODE_UP,      BT_ATTACKNORTH },
+    { SDL_SCANCODE_DOWN,    BT_ATTACKSOUTH },
+    { SDL_SCANCODE_LEFT,    BT_ATTACKWEST },
+    { SDL_SCANCODE_RIGHT,   BT_ATTACKEAST },
+};
+
+#define NUMBINDINGS (int)(sizeof(bindings) / sizeof(bindings[0]))
+
+static inputevent_t queue[INPUT_QUEUE];
+static int          queuehead;
+static int          queuecount;
+
+static uint8_t      keycount[NUMBUTTONS];   // keys down for each button
+static uint32_t     pressed;    // buttons pressed since the last tick
+static uint32_t     active;     // buttons the current tick sees
+
+static bool         latencyon;
+static latency_t    samples[LATENCY_SAMPLES];
+static int          numsamples;
+static int          numpresented;
+
+
+
+static int Binding (SDL_Scancode key)
+{
+    int i;
+
+    for (i=0 ; i<NUMBINDINGS ; i++)
+        if (bindings[i].key == key)
+            return i;
+    return -1;
+}
+
+
+// apply a queued event to the button state
+static void Fold (const inputevent_t *ev)
+{
+    if (ev->down) {
+        keycount[ev->button]++;
+        pressed |= 1 << ev->button;
+    } else if (keycount[ev->button]) {
+        keycount[ev->button]--;
+    }
+}
+
+
+//
+//  Input_Reset
+//  Start over from the keys down now, e.g. at the start of a level
+//
+void Input_Reset (void)
+{
+    const uint8_t *state;
+    int i;
+
+    queuehead = queuecount = 0;
+    pressed = active = 0;
+    memset(keycount, 0, sizeof(keycount));
+
+    state = SDL_GetKeyboardState(NULL);
+    for (i=0 ; i<NUMBINDINGS ; i++)
+        if (state[bindings[i].key])
+            keycount[bindings[i].button]++;
+
+    numsamples = numpresented; // never presented
+}
+
+
+//
+//  Input_Event
+//  Queue event if it's a player key, returns true if it was
+//
+bool Input_Event (const SDL_Event *event)
+{
+    inputevent_t *ev;
+    int b;
+
+    if (event->type != SDL_KEYDOWN && event->type != SDL_KEYUP)
+        return false;
+    if ((b = Binding(event->key.keysym.scancode)) == -1)
+        return false;
+    if (event->key.repeat)
+        return true;
+
+    if (queuecount == INPUT_QUEUE)
+    {
+        // apply the oldest now rather than lose it
+        LogWarn("Input_Event: queue full");
+        Fold(&queue[queuehead]);
+        queuehead = (queuehead + 1) % INPUT_QUEUE;
+        queuecount--;
+    }
+
+    ev = &queue[(queuehead + queuecount++) % INPUT_QUEUE];
+    ev->time = event->key.timestamp;
+    ev->button = bindings[b].button;
+    ev->down = event->type == SDL_KEYDOWN;
+    return true;
+}
+
+
+//
+//  Input_StartTick
+//  Take everything queued for tick. A button is on for the tick if it's
+//  held, or was pressed since the last tick and already let go.
+//
+void Input_StartTick (int tick)
+{
+    inputevent_t *ev;
+    latency_t *s;
+    uint32_t now;
+    int b;
+
+    now = SDL_GetTicks();
+    while (queuecount)
+    {
+        ev = &queue[queuehead];
+        if (ev->down && latencyon && numsamples < LATENCY_SAMPLES)
+        {
+            s = &samples[numsamples++];
+            s->time = ev->time;
+            s->consumed = now;
+            s->presented = 0;
+            s->tick = tick;
+        }
+        Fold(ev);
+        queuehead = (queuehead + 1) % INPUT_QUEUE;
+        queuecount--;
+    }
+
+    active = pressed;
+    for (b=0 ; b<NUMBUTTONS ; b++)
+        if (keycount[b])
+            active |= 1 << b;
+    pressed = 0;
+}
+
+
+bool Input_Button (button_t button)
+{
+    return active & (1 << button);
+}
+
+
+//
+//  Input_SetButtons
+//  Drive the tick from something other than the keyboard, e.g. the
+//  autoplay bot. buttons is a mask of 1 << button.
+//
+void Input_SetButtons (uint32_t buttons)
+{
+    active = buttons;
+}
+
+
+//
+//  Input_Presented
+//  Call after presenting a frame, to time the presses its tick took
+//
+void Input_Presented (void)
+{
+    uint32_t now;
+
+    if (!latencyon || numpresented == numsamples)
+        return;
+
+    now = SDL_GetTicks();
+    for ( ; numpresented<numsamples ; numpresented++)
+    {
+        samples[numpresented].presented = now;
+        LogDebug("input: press at %u ms, tick %d, presented at %u ms",
+                 samples[numpresented].time,
+                 samples[numpresented].tick,
+                 now);
+    }
+
+    if (numsamples == LATENCY_SAMPLES)
+        Input_ReportLatency();
+}
+
+
+
+#pragma mark - Latency
+
+void Input_SetLatency (bool on)
+{
+    latencyon = on;
+    numsamples = numpresented = 0;
+}
+
+
+static int CompareTimes (const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+static uint32_t Percentile (const uint32_t *sorted, int count, int p)
+{
+    return sorted[(count - 1) * p / 100];
+}
+
+
+//
+//  Input_ReportLatency
+//  Log percentiles of the presses presented so far and start over
+//
+void Input_ReportLatency (void)
+{
+    uint32_t    wait[LATENCY_SAMPLES];
+    uint32_t    total[LATENCY_SAMPLES];
+    int         i, n;
+
+    n = numpresented;
+    if (!latencyon || !n)
+        return;
+
+    for (i=0 ; i<n ; i++)
+    {
+        wait[i] = samples[i].consumed - samples[i].time;
+        total[i] = samples[i].presented - samples[i].time;
+    }
+    qsort(wait, n, sizeof(*wait), CompareTimes);
+    qsort(total, n, sizeof(*total), CompareTimes);
+
+    LogInfo("input latency, %d presses: to tick p50 %u p90 %u p99 %u ms, "
+            "to present p50 %u p90 %u p99 %u max %u ms",
+            n,
+            Percentile(wait, n, 50), Percentile(wait, n, 90), Percentile(wait, n, 99),
+            Percentile(total, n, 50), Percentile(total, n, 90), Percentile(total, n, 99),
+            total[n - 1]);
+
+    // keep any not yet presented
+    for (i=n ; i<numsamples ; i++)
+        samples[i - n] = samples[i];
+    numsamples -= n;
+    numpresented = 0;
+}
@@ -0,0 +1,46 @@
+//
+//  input.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef input_h
+#define input_h
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define INPUT_QUEUE         256     // key events waiting for the next tick
+#define LATENCY_SAMPLES     512     // presses per latency report
+
+// the keys the player controls read every tick
+typedef enum
+{
+    BT_NORTH,
+    BT_SOUTH,
+    BT_WEST,
+    BT_EAST,
+    BT_NORTHWEST,
+    BT_NORTHEAST,
+    BT_SOUTHWEST,
+    BT_SOUTHEAST,
+    BT_ATTACKNORTH,
+    BT_ATTACKSOUTH,
+    BT_ATTACKWEST,
+    BT_ATTACKEAST,
+    NUMBUTTONS
+} button_t;
+
+void Input_Reset (void);
+bool Input_Event (const SDL_Event *event);
+void Input_StartTick (int tick);
+bool Input_Button (button_t button);
+void Input_SetButtons (uint32_t buttons);
+void Input_Presented (void);
+
+void Input_SetLatency (bool on);
+void Input_ReportLatency (void);
+
+#endif /* input_h */
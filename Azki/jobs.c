@@ -0,0 +1,96 @@
+//
+//  jobs.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Run a function over many independent jobs on a set of threads. The
+//  threads take batches of jobs from a shared counter until they run
+//  out, so there's no queue to fill and no lock to wait on.
+
+#include <SDL2/SDL.h>
+#include "jobs.h"
+#include "log.h"
+#include "cmdlib.h"
+
+typedef struct
+{
+    jobfunc_t       func;
+    void *          data;
+    int             count;
+    SDL_atomic_t    next;
+} jobrun_t;
+
+typedef struct
+{
+    jobrun_t *      run;
+    int             thread;
+} jobthread_t;
+
+
+
+static int JobThread (void *data)
+{
+    jobthread_t *jt;
+    jobrun_t *run;
+    int job, end;
+
+    jt = data;
+    run = jt->run;
+    while ((job = SDL_AtomicAdd(&run->next, JOB_BATCH)) < run->count)
+    {
+        end = job + JOB_BATCH < run->count ? job + JOB_BATCH : run->count;
+        for ( ; job<end ; job++)
+            run->func(job, jt->thread, run->data);
+    }
+
+    return 0;
+}
+
+
+int Jobs_DefaultThreads (void)
+{
+    return clamp(SDL_GetCPUCount(), 1, MAX_JOB_THREADS);
+}
+
+
+//
+//  Jobs_Run
+//  Call func for each job on numthreads threads (the calling thread is
+//  one of them) and return when all are done
+//
+void Jobs_Run (jobfunc_t func, int count, void *data, int numthreads)
+{
+    SDL_Thread *    threads[MAX_JOB_THREADS];
+    jobthread_t     jt[MAX_JOB_THREADS];
+    jobrun_t        run;
+    int             i;
+
+    if (numthreads < 1)
+        numthreads = Jobs_DefaultThreads();
+    numthreads = clamp(numthreads, 1, MAX_JOB_THREADS);
+
+    run.func = func;
+    run.data = data;
+    run.count = count;
+    SDL_AtomicSet(&run.next, 0);
+
+    for (i=0 ; i<numthreads ; i++)
+    {
+        jt[i].run = &run;
+        jt[i].thread = i;
+        threads[i] = NULL;
+        if (i > 0) {
+            threads[i] = SDL_CreateThread(JobThread, "job", &jt[i]);
+            if (!threads[i])
+                LogWarn("Jobs_Run: couldn't start thread %d", i);
+        }
+    }
+
+    JobThread(&jt[0]);
+
+    for (i=1 ; i<numthreads ; i++)
+        if (threads[i])
+            SDL_WaitThread(threads[i], NULL);
+}
@@ -0,0 +1,21 @@
+//
+//  jobs.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef jobs_h
+#define jobs_h
+
+#define MAX_JOB_THREADS 64
+#define JOB_BATCH       8       // jobs a thread claims at a time
+
+// job is 0...count-1, thread is 0...numthreads-1 for per-thread scratch
+typedef void (* jobfunc_t)(int job, int thread, void *data);
+
+int  Jobs_DefaultThreads (void);
+void Jobs_Run (jobfunc_t func, int count, void *data, int numthreads);
+
+#endif /* jobs_h */
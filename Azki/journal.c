@@ -0,0 +1,224 @@
+//
+//  journal.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Every tile the editor changes is appended to the edit journal, and a
+//  "saved" record follows each map save once it's been written. A clean
+//  quit removes the journal, so if there is one at launch the last
+//  session crashed: any edits after a map's last save are applied to it
+//  and it's saved again.
+//
+//  Records are 8 bytes, little-endian:
+//  u8 kind, u8 layer, u8 x, u8 y, u16 map number, u16 type
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "journal.h"
+#include "writer.h"
+#include "map.h"
+#include "mapcodec.h"
+#include "mem.h"
+#include "log.h"
+
+#define RECORD_SIZE     8
+#define MAX_PENDING     512     // edits buffered between flushes
+
+enum
+{
+    JR_EDIT,
+    JR_SAVED
+};
+
+typedef struct
+{
+    int         kind;
+    int         layer;
+    tile        x;
+    tile        y;
+    int         mapnum;
+    objtype_t   type;
+} record_t;
+
+static byte     pending[MAX_PENDING * RECORD_SIZE];
+static int      numpending;
+
+
+
+static void PackRecord (byte *out, int kind, int mapnum, int layer, tile x, tile y, int type)
+{
+    out[0] = kind;
+    out[1] = layer;
+    out[2] = x;
+    out[3] = y;
+    out[4] = mapnum;
+    out[5] = mapnum >> 8;
+    out[6] = type;
+    out[7] = type >> 8;
+}
+
+
+static void UnpackRecord (const byte *in, record_t *rec)
+{
+    rec->kind = in[0];
+    rec->layer = in[1];
+    rec->x = in[2];
+    rec->y = in[3];
+    rec->mapnum = in[4] | in[5] << 8;
+    rec->type = in[6] | in[7] << 8;
+}
+
+
+
+#pragma mark -
+
+//
+//  Journal_Edit
+//  Record an editor change, written at the next Journal_Flush
+//
+void Journal_Edit (int mapnum, int layer, tile x, tile y, objtype_t type)
+{
+    if (numpending == MAX_PENDING)
+        Journal_Flush();
+
+    PackRecord(&pending[numpending * RECORD_SIZE], JR_EDIT, mapnum, layer, x, y, type);
+    numpending++;
+}
+
+
+//
+//  Journal_Flush
+//  Queue the buffered edits, call once a frame
+//
+void Journal_Flush (void)
+{
+    if (!numpending)
+        return;
+
+    Writer_Append(JOURNAL_FILE, pending, numpending * RECORD_SIZE, 0);
+    numpending = 0;
+}
+
+
+//
+//  Journal_Saved
+//  Call after a map save is queued. The record is only written if the
+//  save was.
+//
+void Journal_Saved (int mapnum)
+{
+    byte record[RECORD_SIZE];
+
+    Journal_Flush();
+    PackRecord(record, JR_SAVED, mapnum, 0, 0, 0, 0);
+    Writer_Append(JOURNAL_FILE, record, RECORD_SIZE, WF_IFNOFAIL);
+}
+
+
+//
+//  Journal_Recover
+//  Replay a crashed session's unsaved edits, call at startup
+//
+void Journal_Recover (void)
+{
+    static map_t    recovered;
+    record_t *      edits;
+    record_t        rec;
+    FILE *          file;
+    byte            in[RECORD_SIZE];
+    obj_t *         obj;
+    int             numedits, maxedits;
+    int             i, j, kept, dropped, mapnum;
+
+    file = fopen(JOURNAL_FILE, "rb");
+    if (!file)
+        return;
+
+    // collect the edits since each map's last save
+    edits = NULL;
+    numedits = maxedits = 0;
+    while (fread(in, RECORD_SIZE, 1, file) == 1)
+    {
+        UnpackRecord(in, &rec);
+        if (rec.kind == JR_SAVED)
+        {
+            for (i=kept=0 ; i<numedits ; i++)
+                if (edits[i].mapnum != rec.mapnum)
+                    edits[kept++] = edits[i];
+            numedits = kept;
+            continue;
+        }
+        if (rec.kind != JR_EDIT || rec.layer > 1 || rec.x >= MAP_W || rec.y >= MAP_H
+            || rec.type >= NUMTYPES)
+            continue; // damaged
+
+        if (numedits == maxedits)
+        {
+            maxedits = maxedits ? maxedits * 2 : 256;
+            edits = Mem_Realloc(MEM_EDITOR, edits, maxedits * sizeof(*edits));
+            if (!edits)
+                Quit("Journal_Recover: could not alloc edits");
+        }
+        edits[numedits++] = rec;
+    }
+    fclose(file);
+
+    // apply them map by map
+    for (i=0 ; i<numedits ; i++)
+    {
+        mapnum = edits[i].mapnum;
+        if (mapnum < 0)
+            continue; // done
+        if (!LoadMap(mapnum, &recovered))
+        {
+            for (j=i, dropped=0 ; j<numedits ; j++)
+            {
+                if (edits[j].mapnum == mapnum) {
+                    edits[j].mapnum = -1; // once per map
+                    dropped++;
+                }
+            }
+            LogWarn("Journal_Recover: map %d is gone, %d edits dropped", mapnum, dropped);
+            continue;
+        }
+
+        kept = 0;
+        for (j=i ; j<numedits ; j++)
+        {
+            if (edits[j].mapnum != mapnum)
+                continue;
+            obj = edits[j].layer
+                ? &recovered.background[edits[j].y][edits[j].x]
+                : &recovered.foreground[edits[j].y][edits[j].x];
+            *obj = NewObjectFromDef(edits[j].type, edits[j].x, edits[j].y);
+            edits[j].mapnum = -1;
+            kept++;
+        }
+
+        LogInfo("Journal_Recover: restored %d unsaved edits to map %d", kept, mapnum);
+        SaveMap(&recovered);
+    }
+    Mem_Free(edits);
+
+    Writer_Flush();
+    if (Writer_Failed())
+        LogError("Journal_Recover: couldn't save recovered maps, keeping %s", JOURNAL_FILE);
+    else
+        Writer_Remove(JOURNAL_FILE);
+}
+
+
+//
+//  Journal_Close
+//  Clean shutdown, edits that weren't saved were meant to be lost
+//
+void Journal_Close (void)
+{
+    numpending = 0;
+    Writer_Flush();
+    if (!Writer_Failed())
+        Writer_Remove(JOURNAL_FILE);
+}
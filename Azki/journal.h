@@ -0,0 +1,23 @@
+//
+//  journal.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef journal_h
+#define journal_h
+
+#include "azki.h"
+#include "obj.h"
+
+#define JOURNAL_FILE    "maps/edit.journal"
+
+void Journal_Edit (int mapnum, int layer, tile x, tile y, objtype_t type);
+void Journal_Flush (void);
+void Journal_Saved (int mapnum);
+void Journal_Recover (void);
+void Journal_Close (void);
+
+#endif /* journal_h */
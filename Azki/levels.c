@@ -0,0 +1,386 @@
+//
+//  levels.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  The level manifest lists every map in play order, one per line:
+//
+//  # num  file        size   crc32     flags  name
+//    1    maps/1.map  12064  3f2a9c10  -      The Lake of Fear
+//    2    maps/2.map  12064  81d0e4b7  dark   The Dark Temple
+//
+//  Flags are "-" or a comma separated list of: dark, pack (the level is
+//  in the map pack instead of its file).
+//
+//  It's read once at startup. If there isn't one, levels come from the
+//  map pack if one is open, otherwise the maps directory is scanned and
+//  a manifest is written for next time.
+//
+//  While a level is played the next one is read and decoded on a
+//  background thread, so going through the exit doesn't touch the disk.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "levels.h"
+#include "pack.h"
+#include "mapcodec.h"
+#include "writer.h"
+#include "cmdlib.h"
+#include "mem.h"
+#include "log.h"
+
+#define MAP_FILE_FMT    "maps/%d.map"
+
+static levelinfo_t  levels[MAX_LEVELS];
+static int          numlevels;
+
+// for maps found without a manifest
+static struct
+{
+    char *  name;
+    int     flags;
+} defaultlevels[] =
+{
+    { " ",                  0 },
+    { "The Lake of Fear",   0 },
+    { "The Dark Temple",    LF_DARK },
+};
+
+static SDL_Thread * prefetchthread;
+static int          prefetchnum;    // level in prefetchmap, 0 if none
+static bool         prefetchok;
+static byte         prefetchdata[MAPFILE_MAX];
+static map_t        prefetchmap;
+
+
+
+#pragma mark - Manifest
+
+static levelinfo_t *AddLevel (int num)
+{
+    levelinfo_t *info;
+    int i;
+
+    if (numlevels == MAX_LEVELS) {
+        LogWarn("AddLevel: too many levels, %d skipped", num);
+        return NULL;
+    }
+
+    // keep sorted by number
+    for (i=numlevels ; i>0 && levels[i-1].num > num ; i--)
+        levels[i] = levels[i-1];
+
+    info = &levels[i];
+    memset(info, 0, sizeof(*info));
+    info->num = num;
+    snprintf(info->file, sizeof(info->file), MAP_FILE_FMT, num);
+    strcpy(info->name, "Untitled");
+    numlevels++;
+
+    return info;
+}
+
+
+//
+//  ScanLevels
+//  No manifest: look for numbered map files
+//
+static void ScanLevels (void)
+{
+    levelinfo_t *info;
+    FILE *file;
+    char path[LEVEL_FILE_LEN];
+    byte *data;
+    long size;
+    int num;
+
+    for (num=1 ; num<=MAX_LEVELS ; num++)
+    {
+        snprintf(path, sizeof(path), MAP_FILE_FMT, num);
+        file = fopen(path, "rb");
+        if (!file)
+            continue;
+
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data = Mem_Alloc(MEM_MAPS, size);
+        if (data && fread(data, size, 1, file) == 1)
+        {
+            info = AddLevel(num);
+            if (info) {
+                info->size = (uint32_t)size;
+                info->crc = CRC32(data, size);
+                if (num < sizeof(defaultlevels) / sizeof(defaultlevels[0])) {
+                    strcpy(info->name, defaultlevels[num].name);
+                    info->flags = defaultlevels[num].flags;
+                }
+            }
+        }
+        Mem_Free(data);
+        fclose(file);
+    }
+}
+
+
+static void LevelsFromPack (void)
+{
+    const packentry_t *entry;
+    levelinfo_t *info;
+    int i;
+
+    for (i=0 ; (entry = Pack_Entry(i)) ; i++)
+    {
+        if (LevelInfo(entry->num) || !(info = AddLevel(entry->num)))
+            continue;
+        info->size = entry->size;
+        info->crc = entry->crc;
+        info->flags = entry->flags | LF_PACKED;
+        snprintf(info->name, sizeof(info->name), "%s", entry->name);
+    }
+}
+
+
+void ReadLevelManifest (void)
+{
+    levelinfo_t *info;
+    FILE *file;
+    char line[256];
+    char flags[32];
+    char *name;
+    int num, len, linenum;
+    unsigned size, crc;
+
+    numlevels = 0;
+    file = fopen(LEVEL_MANIFEST, "r");
+    if (!file && Pack_NumLevels())
+    {
+        LevelsFromPack();
+        LogInfo("ReadLevelManifest: %d levels from the map pack", numlevels);
+        return;
+    }
+    if (!file)
+    {
+        LogInfo("ReadLevelManifest: no %s, scanning maps", LEVEL_MANIFEST);
+        ScanLevels();
+        if (numlevels)
+            WriteLevelManifest();
+        return;
+    }
+
+    linenum = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        linenum++;
+        len = (int)strlen(line);
+        while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+
+        name = line;
+        while (*name == ' ' || *name == '\t')
+            name++;
+        if (*name == '#' || *name == '\0')
+            continue;
+
+        if (sscanf(line, "%d", &num) != 1 || LevelInfo(num)) {
+            LogWarn("%s:%d: bad or duplicate level number", LEVEL_MANIFEST, linenum);
+            continue;
+        }
+        info = AddLevel(num);
+        if (!info)
+            break;
+
+        len = 0;
+        if (sscanf(line, "%*d %63s %u %x %31s %n", info->file, &size, &crc, flags, &len) < 4)
+        {
+            LogWarn("%s:%d: expected num file size crc flags name", LEVEL_MANIFEST, linenum);
+            continue;
+        }
+        info->size = size;
+        info->crc = crc;
+        if (strstr(flags, "dark"))
+            info->flags |= LF_DARK;
+        if (strstr(flags, "pack"))
+            info->flags |= LF_PACKED;
+        if (len && line[len])
+            snprintf(info->name, sizeof(info->name), "%s", line + len);
+    }
+
+    fclose(file);
+    LogInfo("ReadLevelManifest: %d levels", numlevels);
+}
+
+
+//
+//  WriteLevelManifest
+//  Queue the manifest to be written
+//
+void WriteLevelManifest (void)
+{
+    static char text[MAX_LEVELS * 160];
+    levelinfo_t *info;
+    char flags[32];
+    int i, len;
+
+    len = snprintf(text, sizeof(text), "# num  file        size   crc32     flags  name\n");
+    for (i=0, info=levels ; i<numlevels ; i++, info++)
+    {
+        flags[0] = '\0';
+        if (info->flags & LF_DARK)
+            strcat(flags, ",dark");
+        if (info->flags & LF_PACKED)
+            strcat(flags, ",pack");
+        len += snprintf(text + len, sizeof(text) - len,
+                        "%-5d  %-10s  %-5u  %08x  %-5s  %s\n",
+                        info->num, info->file, info->size, info->crc,
+                        flags[0] ? flags + 1 : "-", info->name);
+    }
+
+    Writer_Replace(LEVEL_MANIFEST, text, len);
+}
+
+
+levelinfo_t * LevelInfo (int num)
+{
+    int i;
+
+    for (i=0 ; i<numlevels ; i++)
+    {
+        if (levels[i].num == num)
+            return &levels[i];
+    }
+
+    return NULL;
+}
+
+
+levelinfo_t * LevelList (int *count)
+{
+    *count = numlevels;
+    return levels;
+}
+
+
+//
+//  AdjacentLevel
+//  Number of the next (+1) or previous (-1) level in the manifest,
+//  or 0 if there isn't one
+//
+int AdjacentLevel (int num, int incr)
+{
+    int i;
+
+    if (incr > 0)
+    {
+        for (i=0 ; i<numlevels ; i++)
+            if (levels[i].num > num)
+                return levels[i].num;
+    }
+    else
+    {
+        for (i=numlevels-1 ; i>=0 ; i--)
+            if (levels[i].num < num)
+                return levels[i].num;
+    }
+
+    return 0;
+}
+
+
+//
+//  UpdateLevelInfo
+//  A map file was written, record its new size and checksum
+//
+void UpdateLevelInfo (int num, const void *data, uint32_t size)
+{
+    levelinfo_t *info;
+
+    CancelPrefetch();
+
+    info = LevelInfo(num);
+    if (!info && !(info = AddLevel(num)))
+        return;
+
+    info->size = size;
+    info->crc = CRC32(data, size);
+    info->flags &= ~LF_PACKED; // it's a loose file now
+    WriteLevelManifest();
+}
+
+
+
+#pragma mark - Prefetch
+
+static int PrefetchThread (void *data)
+{
+    const byte *mapdata;
+    size_t size;
+
+    mapdata = ReadMapFile(prefetchnum, prefetchdata, &size);
+    prefetchok = mapdata && DecodeMap(mapdata, size, prefetchnum, &prefetchmap);
+
+    return 0;
+}
+
+
+//
+//  PrefetchLevel
+//  Start reading level num in the background
+//
+void PrefetchLevel (int num)
+{
+    if (!num || !LevelInfo(num))
+        return;
+    if (num == prefetchnum)
+        return; // already have it, or it's on the way
+
+    CancelPrefetch();
+
+    prefetchnum = num;
+    prefetchok = false;
+    prefetchthread = SDL_CreateThread(PrefetchThread, "prefetch", NULL);
+    if (!prefetchthread) {
+        LogWarn("PrefetchLevel: could not start thread: %s", SDL_GetError());
+        prefetchnum = 0;
+    }
+}
+
+
+static void FinishPrefetch (void)
+{
+    if (prefetchthread) {
+        SDL_WaitThread(prefetchthread, NULL);
+        prefetchthread = NULL;
+    }
+}
+
+
+//
+//  TakePrefetchedLevel
+//  Copy level num into dest if it was prefetched, waiting for it to
+//  finish if need be. Returns false if it wasn't.
+//
+bool TakePrefetchedLevel (int num, map_t *dest)
+{
+    if (!num || num != prefetchnum)
+        return false;
+
+    FinishPrefetch();
+    prefetchnum = 0;
+    if (!prefetchok)
+        return false;
+
+    memcpy(dest, &prefetchmap, sizeof(*dest));
+    LogDebug("TakePrefetchedLevel: level %d was ready", num);
+    return true;
+}
+
+
+void CancelPrefetch (void)
+{
+    FinishPrefetch();
+    prefetchnum = 0;
+}
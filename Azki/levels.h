@@ -0,0 +1,44 @@
+//
+//  levels.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef levels_h
+#define levels_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map.h"
+
+#define LEVEL_MANIFEST  "maps/levels.txt"
+#define MAX_LEVELS      100
+#define LEVEL_FILE_LEN  64
+
+#define LF_DARK         0x0001  // unlit except for candles and the player
+#define LF_PACKED       0x0002  // read from the pack, not a loose file
+
+typedef struct
+{
+    int         num;
+    char        name[MAP_NAME_LEN + 1];
+    char        file[LEVEL_FILE_LEN];
+    uint32_t    size;       // 0 if unknown
+    uint32_t    crc;
+    int         flags;
+} levelinfo_t;
+
+void ReadLevelManifest (void);
+void WriteLevelManifest (void);
+levelinfo_t * LevelInfo (int num);
+levelinfo_t * LevelList (int *count);
+int AdjacentLevel (int num, int incr);
+void UpdateLevelInfo (int num, const void *data, uint32_t size);
+
+void PrefetchLevel (int num);
+bool TakePrefetchedLevel (int num, map_t *dest);
+void CancelPrefetch (void);
+
+#endif /* levels_h */
@@ -0,0 +1,309 @@
+//
+//  light.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Candle and player lighting for dark maps. Each light source keeps a
+//  cached patch of light levels computed by recursive shadowcasting over
+//  the solid foreground. A patch is only recast when its source moves or
+//  when a solid tile within its radius changes; the light map is rebuilt
+//  from the cached patches.
+
+#include <string.h>
+#include "light.h"
+#include "player.h"
+#include "cmdlib.h"
+
+#define LIGHT_DIAMETER  (LIGHT_MAX_RADIUS * 2 + 1)
+
+typedef struct
+{
+    obj_t *     obj;        // the candle or player
+    tile        x;          // where the cached patch was cast from
+    tile        y;
+    int         radius;
+    int         intensity;
+    bool        dirty;
+    uint8_t     patch[LIGHT_DIAMETER][LIGHT_DIAMETER];
+} light_t;
+
+uint8_t lightmap[MAP_H][MAP_W];
+bool    darkmap;
+
+static light_t  lights[MAX_LIGHTS];
+static int      numlights;
+
+// one bit per tile (MAP_W <= 64), set if the tile blocks light
+static uint64_t opaque[MAP_H];
+
+// octant transforms for shadowcasting
+static const int mult[4][8] =
+{
+    { 1,  0,  0, -1, -1,  0,  0,  1 },
+    { 0,  1, -1,  0,  0, -1,  1,  0 },
+    { 0,  1,  1,  0,  0, -1, -1,  0 },
+    { 1,  0,  0,  1, -1,  0,  0, -1 }
+};
+
+
+
+static bool BlocksLight (obj_t *obj)
+{
+    return (obj->flags & OF_SOLID) && !(obj->flags & OF_TRANSLUCENT);
+}
+
+
+static bool IsOpaque (tile x, tile y)
+{
+    if (x < 0 || x >= MAP_W || y < 0 || y >= MAP_H)
+        return true;
+    return (opaque[y] >> x) & 1;
+}
+
+
+//
+//  BuildOpaqueRows
+//  Fill 'rows' with the current opaque bits of the foreground
+//
+static void BuildOpaqueRows (uint64_t rows[MAP_H])
+{
+    obj_t *obj;
+    int x, y;
+
+    obj = &map.foreground[0][0];
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        rows[y] = 0;
+        for (x=0 ; x<MAP_W ; x++, obj++)
+        {
+            if (BlocksLight(obj))
+                rows[y] |= (uint64_t)1 << x;
+        }
+    }
+}
+
+
+
+#pragma mark - Shadowcasting
+
+static void LightPatchTile (light_t *l, int dx, int dy)
+{
+    int dist2;
+    int level;
+    uint8_t *p;
+
+    dist2 = dx * dx + dy * dy;
+    level = l->intensity - (l->intensity * dist2) / (l->radius * l->radius + 1);
+    p = &l->patch[dy + LIGHT_MAX_RADIUS][dx + LIGHT_MAX_RADIUS];
+    if (level > *p)
+        *p = level;
+}
+
+
+//
+//  CastLight
+//  Recursive shadowcasting of one octant, see
+//  roguebasin.com "FOV using recursive shadowcasting"
+//
+static void
+CastLight
+( light_t * l,
+  int       row,
+  float     start,
+  float     end,
+  int       xx,
+  int       xy,
+  int       yx,
+  int       yy )
+{
+    int     j, dx, dy;
+    int     ox, oy;     // offset from the source
+    float   lslope, rslope, newstart;
+    bool    blocked;
+
+    if (start < end)
+        return;
+
+    newstart = 0.0f;
+    for (j=row ; j<=l->radius ; j++)
+    {
+        dx = -j - 1;
+        dy = -j;
+        blocked = false;
+
+        while (dx <= 0)
+        {
+            dx++;
+            ox = dx * xx + dy * xy;
+            oy = dx * yx + dy * yy;
+            lslope = (dx - 0.5f) / (dy + 0.5f);
+            rslope = (dx + 0.5f) / (dy - 0.5f);
+
+            if (start < rslope)
+                continue;
+            else if (end > lslope)
+                break;
+
+            if (dx * dx + dy * dy <= l->radius * l->radius)
+                LightPatchTile(l, ox, oy);
+
+            if (blocked)
+            {
+                if (IsOpaque(l->x + ox, l->y + oy)) {
+                    newstart = rslope;
+                    continue;
+                }
+                blocked = false;
+                start = newstart;
+            }
+            else if (IsOpaque(l->x + ox, l->y + oy) && j < l->radius)
+            {
+                blocked = true;
+                CastLight(l, j + 1, start, lslope, xx, xy, yx, yy);
+                newstart = rslope;
+            }
+        }
+
+        if (blocked)
+            break;
+    }
+}
+
+
+static void CastLightPatch (light_t *l)
+{
+    int oct;
+
+    memset(l->patch, 0, sizeof(l->patch));
+    l->x = l->obj->x;
+    l->y = l->obj->y;
+
+    LightPatchTile(l, 0, 0);
+    for (oct=0 ; oct<8 ; oct++)
+    {
+        CastLight(l, 1, 1.0f, 0.0f,
+                  mult[0][oct], mult[1][oct], mult[2][oct], mult[3][oct]);
+    }
+    l->dirty = false;
+}
+
+
+
+#pragma mark -
+
+static void AddLight (obj_t *obj, int radius, int intensity)
+{
+    light_t *l;
+
+    if (numlights == MAX_LIGHTS)
+        return;
+
+    l = &lights[numlights++];
+    l->obj = obj;
+    l->radius = clamp(radius, 1, LIGHT_MAX_RADIUS);
+    l->intensity = intensity;
+    l->dirty = true;
+}
+
+
+//
+//  L_InitLighting
+//  Collect the light sources of the current map, call after the
+//  object list is initialized.
+//
+void L_InitLighting (void)
+{
+    obj_t *obj;
+    int i;
+
+    numlights = 0;
+    darkmap = MapIsDark(map.num);
+    if (!darkmap)
+        return;
+
+    AddLight(player.obj, 5, 200);
+
+    obj = &map.foreground[0][0];
+    for (i=0 ; i<MAP_W*MAP_H ; i++, obj++)
+    {
+        if (obj->type == TYPE_CANDLE)
+            AddLight(obj, 6, LIGHT_FULL);
+    }
+
+    BuildOpaqueRows(opaque);
+}
+
+
+//
+//  L_UpdateLighting
+//  Recast any light that moved or had the solid layer change around it,
+//  then rebuild the light map if anything changed.
+//
+void L_UpdateLighting (void)
+{
+    uint64_t    rows[MAP_H];
+    uint64_t    changed;
+    uint64_t    mask;
+    light_t *   l;
+    bool        rebuild;
+    int         i, x, y;
+    int         x1, x2, y1, y2;
+
+    if (!darkmap)
+        return;
+
+    // invalidate lights around any tiles that became (non-)opaque
+    BuildOpaqueRows(rows);
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        changed = rows[y] ^ opaque[y];
+        if (!changed)
+            continue;
+
+        for (i=0, l=lights ; i<numlights ; i++, l++)
+        {
+            if (y < l->y - l->radius || y > l->y + l->radius)
+                continue;
+            x1 = clamp(l->x - l->radius, 0, MAP_W - 1);
+            x2 = clamp(l->x + l->radius, 0, MAP_W - 1);
+            mask = (((uint64_t)1 << (x2 - x1 + 1)) - 1) << x1;
+            if (changed & mask)
+                l->dirty = true;
+        }
+    }
+    memcpy(opaque, rows, sizeof(opaque));
+
+    rebuild = false;
+    for (i=0, l=lights ; i<numlights ; i++, l++)
+    {
+        if (l->dirty || l->x != l->obj->x || l->y != l->obj->y)
+        {
+            CastLightPatch(l);
+            rebuild = true;
+        }
+    }
+
+    if (!rebuild)
+        return;
+
+    // sum all cached patches into the light map
+    memset(lightmap, LIGHT_AMBIENT, sizeof(lightmap));
+    for (i=0, l=lights ; i<numlights ; i++, l++)
+    {
+        y1 = clamp(l->y - l->radius, 0, MAP_H - 1);
+        y2 = clamp(l->y + l->radius, 0, MAP_H - 1);
+        x1 = clamp(l->x - l->radius, 0, MAP_W - 1);
+        x2 = clamp(l->x + l->radius, 0, MAP_W - 1);
+        for (y=y1 ; y<=y2 ; y++)
+        {
+            for (x=x1 ; x<=x2 ; x++)
+            {
+                int level = lightmap[y][x]
+                    + l->patch[y - l->y + LIGHT_MAX_RADIUS][x - l->x + LIGHT_MAX_RADIUS];
+                lightmap[y][x] = level > LIGHT_FULL ? LIGHT_FULL : level;
+            }
+        }
+    }
+}
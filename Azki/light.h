@@ -0,0 +1,26 @@
+//
+//  light.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef light_h
+#define light_h
+
+#include <stdbool.h>
+#include "map.h"
+
+#define MAX_LIGHTS          64
+#define LIGHT_MAX_RADIUS    8
+#define LIGHT_FULL          255     // no modulation
+#define LIGHT_AMBIENT       0       // light level of unlit tiles in dark maps
+
+extern uint8_t  lightmap[MAP_H][MAP_W];
+extern bool     darkmap;
+
+void L_InitLighting (void);
+void L_UpdateLighting (void);
+
+#endif /* light_h */
@@ -0,0 +1,198 @@
+//
+//  log.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Messages are formatted straight into a slot of a lock-free ring
+//  (bounded multi-producer queue, one sequence number per slot) and a
+//  background thread drains the ring to stderr or the log file. When
+//  the ring is full the message is dropped and counted.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include "log.h"
+
+#define LOG_RECORD_LEN  128
+#define LOG_RING_SIZE   512     // must be a power of 2
+#define LOG_RING_MASK   (LOG_RING_SIZE - 1)
+#define LOG_DRAIN_MS    5
+
+typedef struct
+{
+    SDL_atomic_t    seq;
+    int             level;
+    char            text[LOG_RECORD_LEN];
+} logrecord_t;
+
+static logrecord_t  ring[LOG_RING_SIZE];
+static SDL_atomic_t enqueuepos;
+static unsigned     dequeuepos;     // only touched by the log thread
+static SDL_atomic_t dropped;
+static SDL_atomic_t running;
+
+static SDL_Thread * logthread;
+static FILE *       logfile;
+
+static const char * levelnames[] =
+{
+    "debug",
+    "info",
+    "warning",
+    "error"
+};
+
+
+
+//
+//  DrainLog
+//  Write out everything in the ring, returns the number of messages
+//
+static int DrainLog (void)
+{
+    logrecord_t *rec;
+    int count;
+
+    count = 0;
+    while (1)
+    {
+        rec = &ring[dequeuepos & LOG_RING_MASK];
+        if (SDL_AtomicGet(&rec->seq) != (int)(dequeuepos + 1))
+            break; // empty, or the producer is still writing it
+
+        fprintf(logfile, "[%s] %s\n", levelnames[rec->level], rec->text);
+        SDL_AtomicSet(&rec->seq, (int)(dequeuepos + LOG_RING_SIZE));
+        dequeuepos++;
+        count++;
+    }
+
+    if (count)
+        fflush(logfile);
+    return count;
+}
+
+
+static int LogThread (void *data)
+{
+    while (SDL_AtomicGet(&running))
+    {
+        if (!DrainLog())
+            SDL_Delay(LOG_DRAIN_MS);
+    }
+
+    DrainLog();
+    return 0;
+}
+
+
+
+#pragma mark -
+
+//
+//  Log_Start
+//  Start the log thread, writing to path, or stderr if NULL
+//
+void Log_Start (const char *path)
+{
+    int i;
+
+    if (logthread)
+        return;
+
+    logfile = stderr;
+    if (path)
+    {
+        logfile = fopen(path, "w");
+        if (!logfile) {
+            fprintf(stderr, "Log_Start: could not open %s, using stderr\n", path);
+            logfile = stderr;
+        }
+    }
+
+    for (i=0 ; i<LOG_RING_SIZE ; i++)
+        SDL_AtomicSet(&ring[i].seq, i);
+    SDL_AtomicSet(&enqueuepos, 0);
+    dequeuepos = 0;
+
+    SDL_AtomicSet(&running, 1);
+    logthread = SDL_CreateThread(LogThread, "log", NULL);
+    if (!logthread)
+        SDL_AtomicSet(&running, 0);
+}
+
+
+void Log_Shutdown (void)
+{
+    if (!logthread)
+        return;
+
+    SDL_AtomicSet(&running, 0);
+    SDL_WaitThread(logthread, NULL);
+    logthread = NULL;
+
+    if (SDL_AtomicGet(&dropped))
+        fprintf(logfile, "[warning] log: %d messages dropped\n", SDL_AtomicGet(&dropped));
+    if (logfile != stderr)
+        fclose(logfile);
+    logfile = NULL;
+}
+
+
+void Log_Printf (int level, const char *fmt, ...)
+{
+    va_list         argptr;
+    logrecord_t *   rec;
+    unsigned        pos;
+    int             diff;
+
+    // not started (or shut down): write synchronously
+    if (!SDL_AtomicGet(&running))
+    {
+        fprintf(stderr, "[%s] ", levelnames[level]);
+        va_start(argptr, fmt);
+        vfprintf(stderr, fmt, argptr);
+        va_end(argptr);
+        fprintf(stderr, "\n");
+        return;
+    }
+
+    // claim a slot
+    pos = (unsigned)SDL_AtomicGet(&enqueuepos);
+    while (1)
+    {
+        rec = &ring[pos & LOG_RING_MASK];
+        diff = (int)((unsigned)SDL_AtomicGet(&rec->seq) - pos);
+        if (diff == 0)
+        {
+            if (SDL_AtomicCAS(&enqueuepos, (int)pos, (int)(pos + 1)))
+                break;
+            pos = (unsigned)SDL_AtomicGet(&enqueuepos);
+        }
+        else if (diff < 0)
+        {
+            SDL_AtomicIncRef(&dropped); // full
+            return;
+        }
+        else
+        {
+            pos = (unsigned)SDL_AtomicGet(&enqueuepos);
+        }
+    }
+
+    rec->level = level;
+    va_start(argptr, fmt);
+    vsnprintf(rec->text, LOG_RECORD_LEN, fmt, argptr);
+    va_end(argptr);
+
+    // publish
+    SDL_AtomicSet(&rec->seq, (int)(pos + 1));
+}
+
+
+int Log_Dropped (void)
+{
+    return SDL_AtomicGet(&dropped);
+}
@@ -0,0 +1,59 @@
+//
+//  log.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef log_h
+#define log_h
+
+enum
+{
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_NONE
+};
+
+// messages below LOG_LEVEL are compiled out
+#ifndef LOG_LEVEL
+    #ifdef DEBUG
+        #define LOG_LEVEL LOG_LEVEL_DEBUG
+    #else
+        #define LOG_LEVEL LOG_LEVEL_INFO
+    #endif
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+    #define LogDebug(...)   Log_Printf(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+    #define LogDebug(...)   ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+    #define LogInfo(...)    Log_Printf(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+    #define LogInfo(...)    ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+    #define LogWarn(...)    Log_Printf(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+    #define LogWarn(...)    ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+    #define LogError(...)   Log_Printf(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+    #define LogError(...)   ((void)0)
+#endif
+
+void Log_Start (const char *path);
+void Log_Shutdown (void);
+void Log_Printf (int level, const char *fmt, ...);
+int  Log_Dropped (void);
+
+#endif /* log_h */
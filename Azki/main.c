@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <SDL2/SDL.h>
 #include <unistd.h>
@@ -36,14 +37,41 @@
 #include "video.h"
 #include "map.h"
 #include "cmdlib.h"
+#include "log.h"
+#include "rewind.h"
+#include "levels.h"
+#include "pack.h"
+#include "mapcodec.h"
+#include "writer.h"
+#include "journal.h"
+#include "watch.h"
+#include "undo.h"
+#include "rng.h"
+#include "input.h"
+#include "mem.h"
+#include "trace.h"
 
 const uint8_t * keys;
 
 
 void Quit (const char * error)
 {
+    void EditorShutdown (void);
+    
+    Watch_Shutdown();
+    CancelPrefetch();
+    if (!error || !*error) {
+        EditorShutdown();
+        Journal_Close(); // a clean exit, no need to recover anything
+    }
+    Trace_Stop();
+    Writer_Shutdown();
+    if (CheckParameter("-memaudit"))
+        Mem_Report();
+    Pack_Close();
     List_RemoveAll();
     ShutdownVideo();
+    Log_Shutdown();
     SDL_Quit();
     if (error && *error) {
         puts(error);
@@ -61,6 +89,7 @@ int main(int argc, char ** argv)
     int i;
     int mapnum;
     void EditorLoop (void);
+    bool EditorSelfTest (void);
     
     char buf[120];
     getcwd(buf, sizeof(buf));
@@ -69,13 +98,85 @@ int main(int argc, char ** argv)
     myargc = argc;
     myargv = argv;
     
+    i = CheckParameter("-log");
+    Log_Start(i && i+1 < argc ? argv[i+1] : NULL);
+    i = CheckParameter("-pack");
+    Pack_Open(i && i+1 < argc ? argv[i+1] : PACK_FILE);
+    Writer_Start();
+    ReadLevelManifest();
+    InitMapCodec();
+    Journal_Recover();
+    
+    // rewrite loose maps in the current format and quit
+    if (CheckParameter("-convertmaps")) {
+        if ( !ConvertMaps() )
+            Quit("Could not convert maps!");
+        Quit(NULL);
+    }
+    
+    // check the random number generators, time them and quit
+    if (CheckParameter("-rngtest")) {
+        if ( !Rng_SelfTest() )
+            Quit("Random number self-test failed!");
+        Rng_Benchmark();
+        Quit(NULL);
+    }
+    
+    // check the editor's fill, undo and play test copy and quit
+    if (CheckParameter("-edittest")) {
+        if ( !EditorSelfTest() )
+            Quit("Editor self-test failed!");
+        Quit(NULL);
+    }
+    
+    // build a map pack from the current levels and quit
+    i = CheckParameter("-makepack");
+    if (i) {
+        if ( !Pack_Write(i+1 < argc ? argv[i+1] : PACK_FILE) )
+            Quit("Could not write map pack!");
+        Quit(NULL);
+    }
+    
+    // vsync, free or fps N
+    i = CheckParameter("-present");
+    if (i && i+1 < argc) {
+        if (!strcmp(argv[i+1], "vsync"))
+            SetPresentMode(PRESENT_VSYNC, 0);
+        else if (!strcmp(argv[i+1], "free"))
+            SetPresentMode(PRESENT_FREE, 0);
+        else if (!strcmp(argv[i+1], "fps") && i+2 < argc && atoi(argv[i+2]) > 0)
+            SetPresentMode(PRESENT_FPS, atoi(argv[i+2]));
+        else
+            Quit("-present: expected vsync, free or fps N");
+    }
+    
+    // record zones from startup, written on quit (or F4)
+    i = CheckParameter("-trace");
+    if (i && i+1 < argc)
+        Trace_Start(argv[i+1]);
+    
     StartVideo();
     SeedRandom( (unsigned)time(NULL) );
+    R_Init();
+#ifdef DEVELOPMENT
+    Watch_Start("maps"); // hot reload maps changed on disk
+#endif
     
     keys = SDL_GetKeyboardState(NULL);
     maprect.w = MAP_W * TILE_SIZE;
     maprect.h = MAP_H * TILE_SIZE;
     UpdateDrawLocations(windowed_scale);
+    
+    // log frames that allocate
+    Mem_SetAudit(CheckParameter("-memaudit") != 0);
+    
+    // log how long key presses take to reach the screen
+    Input_SetLatency(CheckParameter("-latency") != 0);
+    
+    // editor undo history, in KB
+    i = CheckParameter("-undokb");
+    if (i && i+1 < argc)
+        Undo_SetBudget((size_t)atoi(argv[i+1]) * 1024);
         
     i = CheckParameter("-edit");
     if (i && i+1 <= argc) {
@@ -89,7 +190,8 @@ int main(int argc, char ** argv)
         }
     } else {
         state = STATE_LEVELSCREEN;
-        if ( !LoadMap(1, &map) ) {
+        mapnum = AdjacentLevel(0, +1);
+        if ( !mapnum || !LoadMap(mapnum, &map) ) {
 #ifdef DEVELOPMENT
             NewMap(1, &map); // in dev, create a new map if none found
             state = STATE_EDIT;
@@ -116,6 +218,7 @@ int main(int argc, char ** argv)
             case STATE_GAMEOVER:
             {
                 S_GameOver();
+                break;
             }
             case STATE_EDIT:
             {
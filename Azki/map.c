@@ -12,6 +12,16 @@
 
 #include "map.h"
 #include "video.h"
+#include "light.h"
+#include "log.h"
+#include "levels.h"
+#include "pack.h"
+#include "mapcodec.h"
+#include "writer.h"
+#include "journal.h"
+#include "mapindex.h"
+#include "cmdlib.h"
+#include "trace.h"
 
 #define MAP_NAME_FMT "maps/%d.map"
 
@@ -22,20 +32,9 @@ SDL_Point   BottomHUD;
 
 bool mapdirty = false;
 
-char *mapnames[] =
-{
-    " ",
-    "The Lake of Fear",
-    "The Dark Temple",
-    "Untitled",
-    "Untitled",
-    "Untitled",
-    "Untitled",
-    "Untitled",
-    "Untitled",
-};
-
-
+// the file map was last loaded from or saved to, for hot reload diffs
+static byte     loadedfile[MAPFILE_MAX];
+static size_t   loadedsize;
 
 //
 // MapName
@@ -43,12 +42,27 @@ char *mapnames[] =
 //
 char *MapName (int mapnum)
 {
-    int numnames;
+    levelinfo_t *info;
 
-    numnames = sizeof(mapnames) / sizeof(mapnames[0]);
-    if (mapnum > numnames)
+    info = LevelInfo(mapnum);
+    if (!info)
         return NULL;
-    return mapnames[mapnum];
+    return info->name;
+}
+
+
+//
+// MapIsDark
+// returns true if given map should be drawn with lighting
+//
+bool MapIsDark (int mapnum)
+{
+    levelinfo_t *info;
+
+    info = LevelInfo(mapnum);
+    if (!info)
+        return false;
+    return info->flags & LF_DARK;
 }
 
 
@@ -75,28 +89,35 @@ int PrintMapName (void)
         PrintString(name, TopHUD.x + offset, TopHUD.y);
     }
 
-    return (int)strlen(mapnum) + (int)strlen(name) + 1;
+    return (int)strlen(mapnum) + (name ? (int)strlen(name) + 1 : 0);
 }
 
 
 
 //
 //  NextLevel
-//  Go to next level by increment +1 or -1
-//  keep looking for the next level if gap
+//  Go to the next level in the manifest by increment +1 or -1,
+//  skipping any that won't load
 //
 void NextLevel (int incr)
 {
     int next;
     
-    next = map.num + incr;
-    while (next > 0 && next <= 100)
+    next = AdjacentLevel(map.num, incr);
+    while (next)
     {
-        printf("trying to load %d...\n", next);
+        if ( TakePrefetchedLevel(next, &map) )
+        {
+            loadedsize = EncodeMap(&map, loadedfile, sizeof(loadedfile));
+            mapdirty = false;
+            return;
+        }
         if ( LoadMap(next, &map) )
+        {
+            mapdirty = false;
             return;
-        else
-            next += incr;
+        }
+        next = AdjacentLevel(next, incr);
     }
 }
 
@@ -104,40 +125,145 @@ void NextLevel (int incr)
 
 
 //
-//  LoadMap
-//  Read map file data into 'map'
+//  ReadMapFile
+//  Get a level's map file, checked against the level manifest. Packed
+//  levels are returned in place from the map pack, loose files are read
+//  into 'buffer' (MAPFILE_MAX bytes). Returns NULL if it couldn't be read.
+//  Safe to call from the prefetch thread.
 //
-bool LoadMap (int mapnum, map_t * map)
+const byte * ReadMapFile (int mapnum, byte * buffer, size_t * size)
 {
-    FILE *      file;
-    char        filename[80];
-    mapdata_t   mapdata;
-    int         x, y;
+    FILE *              file;
+    char                filename[300];  // room for a -pack path
+    levelinfo_t *       info;
+    const packentry_t * entry;
+    const byte *        data;
+    uint32_t            crc;
     
-    sprintf(filename, MAP_NAME_FMT, mapnum);
-    printf("Loading map %d...\n", mapnum);
-    file = fopen(filename, "rb");
-    if (!file)
+    info = LevelInfo(mapnum);
+    if (info && info->flags & LF_PACKED)
     {
-        fclose(file);
-        printf("LoadFile: Quit, couldn't load %s\n", filename);
-        return false;
+        snprintf(filename, sizeof(filename), "level %d in %s", mapnum, Pack_Path());
+        entry = Pack_FindLevel(mapnum);
+        if (!entry)
+        {
+            LogWarn("ReadMapFile: no %s", filename);
+            return NULL;
+        }
+        data = Pack_LevelData(entry);
+        *size = entry->size;
+    }
+    else
+    {
+        if (info)
+            strcpy(filename, info->file);
+        else
+            sprintf(filename, MAP_NAME_FMT, mapnum);
+        
+        // a save may still be on its way to the disk
+        if (!Writer_PendingData(filename, buffer, MAPFILE_MAX, size))
+        {
+            file = fopen(filename, "rb");
+            if (!file)
+            {
+                LogWarn("ReadMapFile: couldn't load %s", filename);
+                return NULL;
+            }
+            
+            *size = fread(buffer, 1, MAPFILE_MAX, file);
+            if (!feof(file))
+            {
+                fclose(file);
+                LogWarn("ReadMapFile: %s is too big", filename);
+                return NULL;
+            }
+            fclose(file);
+        }
+        data = buffer;
     }
     
-    fread(&mapdata, sizeof(mapdata_t), 1, file);
-    fclose(file);
-    
-    for (y=0 ; y<MAP_H ; y++)
+    if (info && info->size)
     {
-        for (x=0 ; x<MAP_W ; x++)
+        crc = CRC32(data, *size);
+        if (info->size != *size || info->crc != crc)
         {
-            map->background[y][x] = NewObjectFromDef(mapdata.background[y][x], x, y);
-            map->foreground[y][x] = NewObjectFromDef(mapdata.foreground[y][x], x, y);
+            LogWarn("ReadMapFile: %s doesn't match %s (crc %08x, expected %08x)",
+                    filename, LEVEL_MANIFEST, crc, info->crc);
+#ifndef DEVELOPMENT
+            return NULL;
+#endif
         }
     }
     
-    map->num = mapnum;
+    return data;
+}
+
+
+
+
+//
+//  SetLoadedMapFile
+//  Remember the file the current map matches
+//
+void SetLoadedMapFile (const byte * data, size_t size)
+{
+    if (size > sizeof(loadedfile)) {
+        loadedsize = 0;
+        return;
+    }
+    memcpy(loadedfile, data, size);
+    loadedsize = size;
+}
+
+
+//
+//  LoadedMapFile
+//  The file the current map was loaded from or last saved to, NULL if
+//  not known
+//
+const byte * LoadedMapFile (size_t * size)
+{
+    *size = loadedsize;
+    return loadedsize ? loadedfile : NULL;
+}
+
+
+static bool IsCurrentMap (const map_t * m)
+{
+    return m == &map;
+}
+
+
+
+
+//
+//  LoadMap
+//  Read map file data into 'map'
+//
+bool LoadMap (int mapnum, map_t * map)
+{
+    byte            buffer[MAPFILE_MAX];
+    const byte *    data;
+    size_t          size;
+    uint64_t        start;
+    
+    LogInfo("Loading map %d...", mapnum);
+    TraceBegin("LoadMap");
+    data = ReadMapFile(mapnum, buffer, &size);
+    start = SDL_GetPerformanceCounter();
+    if (!data || !DecodeMap(data, size, mapnum, map)) {
+        TraceEnd("LoadMap");
+        return false;
+    }
+    if (IsCurrentMap(map))
+        SetLoadedMapFile(data, size);
+    LogDebug("LoadMap: version %d, %zu bytes, decoded in %.3f ms",
+             MapFileVersion(data, size), size,
+             (SDL_GetPerformanceCounter() - start) * 1000.0
+             / SDL_GetPerformanceFrequency());
+    
     mapdirty = false;
+    TraceEnd("LoadMap");
     
     return true;
 }
@@ -146,41 +272,58 @@ bool LoadMap (int mapnum, map_t * map)
 
 
 //
-//  SaveMap
-//  Save map to file
+//  WriteMapFile
+//  Encode map and queue it to be written to its file
 //
-bool SaveMap (map_t * map)
+static bool WriteMapFile (map_t * map)
 {
-    FILE        *stream;
-    char        filename[80];
-    int         x, y;
-    mapdata_t   mapdata;
+    char            filename[80];
+    byte            data[MAPFILE_MAX];
+    size_t          size;
+    levelinfo_t *   info;
     
-    sprintf(filename, MAP_NAME_FMT, map->num);
-    stream = fopen(filename, "wb");
-    if (!stream)
-    {
-        fclose(stream);
-        printf("SaveMap: Quit, couldn't open %s!\n", filename);
+    info = LevelInfo(map->num);
+    if (info)
+        strcpy(filename, info->file);
+    else
+        sprintf(filename, MAP_NAME_FMT, map->num);
+    
+    size = EncodeMap(map, data, sizeof(data));
+    if (!size) {
+        LogError("WriteMapFile: couldn't encode map %d!", map->num);
         return false;
     }
     
-    for (y=0 ; y<MAP_H ; y++)
-    {
-        for (x=0 ; x<MAP_W ; x++)
-        {
-            mapdata.background[y][x] = map->background[y][x].type;
-            mapdata.foreground[y][x] = map->foreground[y][x].type;
-        }
-    }
+    Writer_Replace(filename, data, size);
+    if (IsCurrentMap(map))
+        SetLoadedMapFile(data, size);
+    UpdateLevelInfo(map->num, data, (uint32_t)size);
+    Index_UpdateMap(map, CRC32(data, size));
+    LogInfo("WriteMapFile: saving %s, %zu bytes", filename, size);
     
-    fwrite(&mapdata, sizeof(mapdata), 1, stream);
-    fclose(stream);
-    printf("SaveMap: saved %s\n", filename);
+    return true;
+}
+
+
+
+
+//
+//  SaveMap
+//  Save map to file
+//
+bool SaveMap (map_t * map)
+{
+    bool ok;
     
-    mapdirty = false;
+    TraceBegin("SaveMap");
+    ok = WriteMapFile(map);
+    if (ok) {
+        Journal_Saved(map->num);
+        mapdirty = false;
+    }
+    TraceEnd("SaveMap");
     
-    return true;
+    return ok;
 }
 
 
@@ -192,20 +335,9 @@ bool SaveMap (map_t * map)
 //
 bool NewMap (int num, map_t * map)
 {
-    FILE        *stream;
     int         x, y;
-    char        filename[80];
-    mapdata_t   mapdata;
     
-    sprintf(filename, MAP_NAME_FMT, num);
-    printf("New map, creating %s...\n", filename);
-    
-    stream = fopen(filename, "wb");
-    if (!stream) {
-        printf("NewMap: could not create file %s!\n", filename);
-        return false;
-    }
-
+    LogInfo("New map %d...", num);
     map->num = num;
     
     // empty map
@@ -215,16 +347,11 @@ bool NewMap (int num, map_t * map)
         {
             map->foreground[y][x] = NewObjectFromDef(TYPE_NONE, x, y);
             map->background[y][x] = NewObjectFromDef(TYPE_NONE, x, y);
-            mapdata.foreground[y][x] = TYPE_NONE;
-            mapdata.background[y][x] = TYPE_NONE;
         }
     }
     
-    if ( fwrite(&mapdata, sizeof(mapdata), 1, stream) != 1 ) {
-        printf("NewMap: could not write map to file %s!\n", filename);
+    if (!WriteMapFile(map))
         return false;
-    }
-    fclose(stream);
     
     mapdirty = false;
     
@@ -234,6 +361,73 @@ bool NewMap (int num, map_t * map)
 
 
 
+//
+//  ConvertMaps
+//  Rewrite every loose map file in the current encoding, checking that
+//  each one decodes back to the same map
+//
+bool ConvertMaps (void)
+{
+    static map_t    before;
+    static map_t    after;
+    static byte     old[MAPFILE_MAX];
+    static byte     new[MAPFILE_MAX];
+    const byte *    data;
+    levelinfo_t *   info;
+    size_t          oldsize, newsize;
+    size_t          oldtotal, newtotal;
+    uint64_t        start;
+    double          oldms, newms;
+    int             i, j, count;
+    const int       reps = 100;
+    
+    oldtotal = newtotal = 0;
+    info = LevelList(&count);
+    for (i=0 ; i<count ; i++, info++)
+    {
+        if (info->flags & LF_PACKED)
+            continue;
+        data = ReadMapFile(info->num, old, &oldsize);
+        if (!data || !DecodeMap(data, oldsize, info->num, &before))
+            return false;
+        
+        newsize = EncodeMap(&before, new, sizeof(new));
+        if (!newsize || !DecodeMap(new, newsize, info->num, &after)
+            || memcmp(&before, &after, sizeof(before)))
+        {
+            LogError("ConvertMaps: map %d doesn't survive re-encoding!", info->num);
+            return false;
+        }
+        
+        start = SDL_GetPerformanceCounter();
+        for (j=0 ; j<reps ; j++)
+            DecodeMap(data, oldsize, info->num, &after);
+        oldms = (SDL_GetPerformanceCounter() - start) * 1000.0
+            / SDL_GetPerformanceFrequency() / reps;
+        
+        start = SDL_GetPerformanceCounter();
+        for (j=0 ; j<reps ; j++)
+            DecodeMap(new, newsize, info->num, &after);
+        newms = (SDL_GetPerformanceCounter() - start) * 1000.0
+            / SDL_GetPerformanceFrequency() / reps;
+        
+        LogInfo("map %d: version %d %zu bytes %.3f ms -> version %d %zu bytes %.3f ms",
+                info->num, MapFileVersion(data, oldsize), oldsize, oldms,
+                MAPFILE_VERSION, newsize, newms);
+        oldtotal += oldsize;
+        newtotal += newsize;
+        
+        if (!WriteMapFile(&before))
+            return false;
+    }
+    
+    LogInfo("ConvertMaps: %zu bytes -> %zu bytes", oldtotal, newtotal);
+    return true;
+}
+
+
+
+
 void DrawMapBackground (void)
 {
     const int   margin = 3;
@@ -249,22 +443,47 @@ void DrawMapBackground (void)
 
 
 
+//
+//  UpdateMapObjects
+//  Run the updates of objects that live in the foreground layer, e.g.
+//  water and candles. Once a tick, from RunTick.
+//
+void UpdateMapObjects (map_t *map)
+{
+    obj_t * fg;
+    int     i;
+    
+    TraceBegin("UpdateMapObjects");
+    fg = &map->foreground[0][0];
+    for (i=0 ; i<MAP_W*MAP_H ; i++, fg++)
+        if (fg->update)
+            fg->update(fg);
+    TraceEnd("UpdateMapObjects");
+}
+
+
+
 void DrawMap (map_t *map)
 {
     obj_t *     fg;
     obj_t *     bg;
+    uint8_t *   light;
     int         i;
     
+    TraceBegin("DrawMap");
     DrawMapBackground();
     
     // draw all objects
     fg = &map->foreground[0][0];
     bg = &map->background[0][0];
-    for (i=0 ; i<MAP_W*MAP_H ; i++)
+    light = &lightmap[0][0];
+    for (i=0 ; i<MAP_W*MAP_H ; i++, light++)
     {
-        if (fg->update)
-            fg->update(fg);
+        if (darkmap)
+            SetLightLevel(*light);
         DrawObject(bg++);
         DrawObject(fg++);
     }
+    SetLightLevel(LIGHT_FULL);
+    TraceEnd("DrawMap");
 }
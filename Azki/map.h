@@ -12,6 +12,7 @@
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 #include "obj.h"
+#include "cmdlib.h"
 
 #define MAP_TOP_MARGIN  3 * TILE_SIZE
 #define MAP_SIDE_MARGIN 2 * TILE_SIZE
@@ -28,6 +29,7 @@ typedef struct map_s
     layer_t background;
 } map_t;
 
+// map file version 1
 typedef struct
 {
     objtype_t foreground[MAP_H][MAP_W];
@@ -44,11 +46,17 @@ extern bool         mapdirty;
 int PrintMapName (void);
 void NextLevel (int incr);
 
+const byte * ReadMapFile (int mapnum, byte * buffer, size_t * size);
+void SetLoadedMapFile (const byte * data, size_t size);
+const byte * LoadedMapFile (size_t * size);
 bool LoadMap (int mapnum, map_t * map);
 bool NewMap (int num, map_t * map);
 bool SaveMap (map_t * map);
+bool ConvertMaps (void);
 
+void UpdateMapObjects (map_t *map);
 void DrawMap (map_t *map);
 char *MapName (int mapnum);
+bool MapIsDark (int mapnum);
 
 #endif /* map_h */
@@ -0,0 +1,669 @@
+//
+//  mapcodec.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Map file encoding, version 3. All fields are little-endian.
+//
+//  "AZM" 3             magic and version
+//  u32 size            bytes of chunks that follow
+//  u32 crc             CRC-32 of the chunks
+//  chunks              char id[4], u32 length, payload
+//
+//  "TILE" (required)   u8 flags, then foreground rows, [row mask],
+//                      background rows:
+//                      A row is a list of runs (varint count, type byte)
+//                      that add up to exactly MAP_W. With MF_BGMASK a
+//                      varint has bit y set if background row y is
+//                      stored, the others are all TYPE_NONE.
+//  "INST" (optional)   u16 count, then for each tile that differs from
+//                      its type's defaults: u8 layer, u8 x, u8 y,
+//                      u8 IF_ fields, then each field present in order:
+//                      glyph (u8 char, fg, bg), hp (s16), damage (s16),
+//                      facing (s8 dx, dy)
+//
+//  Unknown chunks are skipped. The whole file is checked (size, CRC,
+//  chunk bounds) before anything is decoded, and tiles are copied from
+//  per-type template objects.
+//
+//  Older versions still load: 2 is "AZM" 2, u8 flags and the TILE rows
+//  with no chunks or CRC, 1 is a bare mapdata_t of little-endian u32s.
+
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "mapcodec.h"
+#include "mem.h"
+#include "log.h"
+
+#define HEADER_SIZE     12
+#define CHUNK_HEADER    8
+
+#define MF_BGMASK       0x01    // empty background rows are left out
+
+// instance fields
+#define IF_GLYPH        0x01
+#define IF_HP           0x02
+#define IF_DAMAGE       0x04
+#define IF_FACING       0x08
+
+#define INSTANCE_MAX    (4 + 3 + 2 + 2 + 2)
+
+// a fresh object of each type, tiles are copies of these
+static obj_t    templates[NUMTYPES];
+static bool     templatesready;
+static SDL_TLSID scratchkey;     // each thread's map to decode into
+
+
+
+#pragma mark - Fields
+
+static void PutU16 (byte *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void PutU32 (byte *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint16_t GetU16 (const byte *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t GetU32 (const byte *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+static byte *WriteVarint (byte *out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (byte)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (byte)value;
+    return out;
+}
+
+
+static const byte *ReadVarint (const byte *in, const byte *end, uint32_t *value)
+{
+    uint32_t result;
+    int shift;
+
+    result = 0;
+    for (shift=0 ; shift<35 && in<end ; shift+=7)
+    {
+        result |= (uint32_t)(*in & 0x7F) << shift;
+        if (!(*in++ & 0x80)) {
+            *value = result;
+            return in;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+#pragma mark - Encoding
+
+// worst case: every tile its own run
+#define MAX_ROW_BYTES   (MAP_W * 2)
+
+static byte *EncodeRow (const obj_t *row, byte *out)
+{
+    int x, run;
+
+    x = 0;
+    while (x < MAP_W)
+    {
+        run = 1;
+        while (x + run < MAP_W && row[x + run].type == row[x].type)
+            run++;
+        out = WriteVarint(out, run);
+        *out++ = (byte)row[x].type;
+        x += run;
+    }
+
+    return out;
+}
+
+
+static bool RowIsEmpty (const obj_t *row)
+{
+    int x;
+
+    for (x=0 ; x<MAP_W ; x++)
+    {
+        if (row[x].type != TYPE_NONE)
+            return false;
+    }
+
+    return true;
+}
+
+
+static byte *EncodeTiles (const map_t *map, byte *out)
+{
+    uint32_t    mask;
+    int         y;
+
+    mask = 0;
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        if (!RowIsEmpty(map->background[y]))
+            mask |= 1u << y;
+    }
+
+    *out++ = mask == (1u << MAP_H) - 1 ? 0 : MF_BGMASK;
+    for (y=0 ; y<MAP_H ; y++)
+        out = EncodeRow(map->foreground[y], out);
+    if (mask != (1u << MAP_H) - 1)
+        out = WriteVarint(out, mask);
+
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        if (mask & (1u << y))
+            out = EncodeRow(map->background[y], out);
+    }
+
+    return out;
+}
+
+
+//
+//  InstanceFields
+//  Which of obj's saved fields differ from its type's defaults.
+//  Objects with an update action animate their glyph (water, candles),
+//  so theirs isn't saved.
+//
+static int InstanceFields (const obj_t *obj)
+{
+    const obj_t *def;
+    int fields;
+
+    def = &templates[obj->type];
+    fields = 0;
+    if (!obj->update && memcmp(&obj->glyph, &def->glyph, sizeof(glyph_t)))
+        fields |= IF_GLYPH;
+    if (obj->hp != def->hp)
+        fields |= IF_HP;
+    if (obj->damage != def->damage)
+        fields |= IF_DAMAGE;
+    if (obj->dx || obj->dy)
+        fields |= IF_FACING;
+
+    return fields;
+}
+
+
+static byte *EncodeInstance (const obj_t *obj, int layer, int fields, byte *out)
+{
+    *out++ = layer;
+    *out++ = obj->x;
+    *out++ = obj->y;
+    *out++ = fields;
+
+    if (fields & IF_GLYPH) {
+        *out++ = obj->glyph.character;
+        *out++ = obj->glyph.fg_color;
+        *out++ = obj->glyph.bg_color;
+    }
+    if (fields & IF_HP) {
+        PutU16(out, (int16_t)obj->hp);
+        out += 2;
+    }
+    if (fields & IF_DAMAGE) {
+        PutU16(out, (int16_t)obj->damage);
+        out += 2;
+    }
+    if (fields & IF_FACING) {
+        *out++ = (int8_t)obj->dx;
+        *out++ = (int8_t)obj->dy;
+    }
+
+    return out;
+}
+
+
+//
+//  EncodeInstances
+//  Writes the INST payload, returns NULL if it doesn't fit
+//
+static byte *EncodeInstances (const map_t *map, byte *out, byte *end, int *count)
+{
+    const obj_t *   obj;
+    byte *          start;
+    int             layer, i, fields;
+
+    start = out;
+    out += 2;
+    *count = 0;
+    for (layer=0 ; layer<2 ; layer++)
+    {
+        obj = layer ? &map->background[0][0] : &map->foreground[0][0];
+        for (i=0 ; i<MAP_W*MAP_H ; i++, obj++)
+        {
+            fields = InstanceFields(obj);
+            if (!fields)
+                continue;
+            if (out + INSTANCE_MAX > end)
+                return NULL;
+            out = EncodeInstance(obj, layer, fields, out);
+            (*count)++;
+        }
+    }
+
+    PutU16(start, *count);
+    return out;
+}
+
+
+static byte *BeginChunk (byte *out, const char *id)
+{
+    memcpy(out, id, 4);
+    return out + CHUNK_HEADER;
+}
+
+
+static void EndChunk (byte *chunk, byte *end)
+{
+    PutU32(chunk + 4, (uint32_t)(end - chunk - CHUNK_HEADER));
+}
+
+
+//
+//  EncodeMap
+//  Returns the encoded size, or 0 if out is too small
+//
+size_t EncodeMap (const map_t *map, byte *out, size_t outsize)
+{
+    byte *  chunk;
+    byte *  end;
+    byte *  p;
+    int     count;
+
+    InitMapCodec();
+    if (outsize < HEADER_SIZE + CHUNK_HEADER * 2 + 6 + MAX_ROW_BYTES * MAP_H * 2)
+        return 0;
+
+    memcpy(out, MAPFILE_MAGIC, 3);
+    out[3] = MAPFILE_VERSION;
+
+    chunk = out + HEADER_SIZE;
+    p = EncodeTiles(map, BeginChunk(chunk, "TILE"));
+    EndChunk(chunk, p);
+
+    chunk = p;
+    p = EncodeInstances(map, BeginChunk(chunk, "INST"), out + outsize, &count);
+    if (!p)
+        return 0;
+    if (count)
+        EndChunk(chunk, p);
+    else
+        p = chunk; // no chunk
+    end = p;
+
+    PutU32(out + 4, (uint32_t)(end - out - HEADER_SIZE));
+    PutU32(out + 8, CRC32(out + HEADER_SIZE, end - out - HEADER_SIZE));
+
+    return end - out;
+}
+
+
+//
+//  EncodeMapVersion1
+//  The old bare mapdata_t format, for tools that still read it. Only
+//  tile types are kept. Returns 0 if out is too small.
+//
+size_t EncodeMapVersion1 (const map_t *map, byte *out, size_t outsize)
+{
+    byte *  fg;
+    byte *  bg;
+    int     x, y;
+
+    if (outsize < sizeof(mapdata_t))
+        return 0;
+
+    fg = out + offsetof(mapdata_t, foreground);
+    bg = out + offsetof(mapdata_t, background);
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        for (x=0 ; x<MAP_W ; x++, fg+=4, bg+=4)
+        {
+            PutU32(fg, map->foreground[y][x].type);
+            PutU32(bg, map->background[y][x].type);
+        }
+    }
+
+    return sizeof(mapdata_t);
+}
+
+
+
+#pragma mark - Decoding
+
+//
+//  InitMapCodec
+//  Build the template objects. Called from the main thread before any
+//  map is decoded.
+//
+void InitMapCodec (void)
+{
+    int type;
+
+    if (templatesready)
+        return;
+
+    for (type=0 ; type<NUMTYPES ; type++)
+        templates[type] = NewObjectFromDef(type, 0, 0);
+    scratchkey = SDL_TLSCreate();
+    templatesready = true;
+}
+
+
+//
+//  Scratch
+//  The calling thread's map to decode into, too big for a thread's stack
+//
+static map_t *Scratch (void)
+{
+    map_t *scratch;
+
+    scratch = SDL_TLSGet(scratchkey);
+    if (!scratch)
+    {
+        scratch = Mem_Alloc(MEM_MAPS, sizeof(*scratch));
+        if (scratch)
+            SDL_TLSSet(scratchkey, scratch, Mem_Free);
+    }
+    return scratch;
+}
+
+
+//
+//  DecodeRow
+//  Fill a row of objects from its runs. Returns NULL if the row is bad.
+//
+static const byte *DecodeRow (const byte *in, const byte *end, obj_t *row, tile y)
+{
+    const obj_t *   proto;
+    obj_t *         dst;
+    uint32_t        count;
+    byte            type;
+    tile            x;
+
+    x = 0;
+    dst = row;
+    while (x < MAP_W)
+    {
+        in = ReadVarint(in, end, &count);
+        if (!in || in == end)
+            return NULL;
+        type = *in++;
+        if (type >= NUMTYPES || count == 0 || count > MAP_W - x)
+            return NULL;
+
+        proto = &templates[type];
+        while (count--)
+        {
+            *dst = *proto;
+            dst->x = x++;
+            dst->y = y;
+            dst++;
+        }
+    }
+
+    return in;
+}
+
+
+static void EmptyRow (obj_t *row, tile y)
+{
+    tile x;
+
+    for (x=0 ; x<MAP_W ; x++)
+    {
+        row[x] = templates[TYPE_NONE];
+        row[x].x = x;
+        row[x].y = y;
+    }
+}
+
+
+//
+//  DecodeTiles
+//  The TILE payload, also all of a version 2 file after its header
+//
+static bool DecodeTiles (const byte *in, const byte *end, map_t *map)
+{
+    uint32_t    mask;
+    byte        flags;
+    int         y;
+
+    if (in == end)
+        return false;
+    flags = *in++;
+
+    for (y=0 ; y<MAP_H && in ; y++)
+        in = DecodeRow(in, end, map->foreground[y], y);
+    if (!in)
+        return false;
+
+    mask = (1u << MAP_H) - 1;
+    if (flags & MF_BGMASK)
+    {
+        in = ReadVarint(in, end, &mask);
+        if (!in)
+            return false;
+    }
+
+    for (y=0 ; y<MAP_H && in ; y++)
+    {
+        if (mask & (1u << y))
+            in = DecodeRow(in, end, map->background[y], y);
+        else
+            EmptyRow(map->background[y], y);
+    }
+
+    return in != NULL;
+}
+
+
+static bool DecodeInstances (const byte *in, const byte *end, map_t *map)
+{
+    obj_t * obj;
+    int     count;
+    int     layer, x, y, fields, size;
+
+    if (end - in < 2)
+        return false;
+    count = GetU16(in);
+    in += 2;
+
+    while (count--)
+    {
+        if (end - in < 4)
+            return false;
+        layer = in[0];
+        x = in[1];
+        y = in[2];
+        fields = in[3];
+        in += 4;
+
+        size = (fields & IF_GLYPH ? 3 : 0) + (fields & IF_HP ? 2 : 0)
+            + (fields & IF_DAMAGE ? 2 : 0) + (fields & IF_FACING ? 2 : 0);
+        if (layer > 1 || x >= MAP_W || y >= MAP_H || end - in < size)
+            return false;
+
+        obj = layer ? &map->background[y][x] : &map->foreground[y][x];
+        if (fields & IF_GLYPH) {
+            obj->glyph.character = in[0];
+            obj->glyph.fg_color = in[1];
+            obj->glyph.bg_color = in[2];
+            in += 3;
+        }
+        if (fields & IF_HP) {
+            obj->hp = (int16_t)GetU16(in);
+            in += 2;
+        }
+        if (fields & IF_DAMAGE) {
+            obj->damage = (int16_t)GetU16(in);
+            in += 2;
+        }
+        if (fields & IF_FACING) {
+            obj->dx = (int8_t)in[0];
+            obj->dy = (int8_t)in[1];
+            in += 2;
+        }
+    }
+
+    return true;
+}
+
+
+//
+//  DecodeVersion3
+//  Check the size, CRC and chunk bounds, then decode the chunks
+//
+static bool DecodeVersion3 (const byte *data, size_t size, map_t *map)
+{
+    const byte *chunk;
+    const byte *end;
+    const byte *tiles;
+    const byte *instances;
+    uint32_t    length;
+    uint32_t    tileslength, instanceslength;
+
+    if (size < HEADER_SIZE || GetU32(data + 4) != size - HEADER_SIZE)
+        return false;
+    if (GetU32(data + 8) != CRC32(data + HEADER_SIZE, size - HEADER_SIZE))
+        return false;
+
+    tiles = instances = NULL;
+    tileslength = instanceslength = 0;
+    end = data + size;
+    for (chunk = data + HEADER_SIZE ; chunk < end ; chunk += CHUNK_HEADER + length)
+    {
+        if (end - chunk < CHUNK_HEADER)
+            return false;
+        length = GetU32(chunk + 4);
+        if (length > end - chunk - CHUNK_HEADER)
+            return false;
+
+        if (!memcmp(chunk, "TILE", 4)) {
+            tiles = chunk + CHUNK_HEADER;
+            tileslength = length;
+        } else if (!memcmp(chunk, "INST", 4)) {
+            instances = chunk + CHUNK_HEADER;
+            instanceslength = length;
+        }
+    }
+
+    if (!tiles || !DecodeTiles(tiles, tiles + tileslength, map))
+        return false;
+    if (instances && !DecodeInstances(instances, instances + instanceslength, map))
+        return false;
+
+    return true;
+}
+
+
+static bool DecodeVersion1 (const byte *data, map_t *map)
+{
+    const byte *fg;
+    const byte *bg;
+    uint32_t    fgtype, bgtype;
+    int         x, y;
+
+    fg = data + offsetof(mapdata_t, foreground);
+    bg = data + offsetof(mapdata_t, background);
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        for (x=0 ; x<MAP_W ; x++, fg+=4, bg+=4)
+        {
+            fgtype = GetU32(fg);
+            bgtype = GetU32(bg);
+            if (fgtype >= NUMTYPES || bgtype >= NUMTYPES)
+                return false;
+            map->foreground[y][x] = templates[fgtype];
+            map->foreground[y][x].x = x;
+            map->foreground[y][x].y = y;
+            map->background[y][x] = templates[bgtype];
+            map->background[y][x].x = x;
+            map->background[y][x].y = y;
+        }
+    }
+
+    return true;
+}
+
+
+//
+//  MapFileVersion
+//  Returns 0 if data isn't a map file
+//
+int MapFileVersion (const byte *data, size_t size)
+{
+    if (size > 5 && !memcmp(data, MAPFILE_MAGIC, 3))
+        return data[3];
+    if (size == sizeof(mapdata_t))
+        return 1;
+    return 0;
+}
+
+
+//
+//  DecodeMap
+//  Make map objects from map file data of any version. It's decoded aside
+//  first, so map is left as it was if the data is damaged.
+//
+bool DecodeMap (const byte *data, size_t size, int mapnum, map_t *map)
+{
+    map_t *scratch;
+    bool ok;
+
+    InitMapCodec();
+    scratch = Scratch();
+    if (!scratch) {
+        LogError("DecodeMap: no memory to decode map %d", mapnum);
+        return false;
+    }
+
+    switch (MapFileVersion(data, size))
+    {
+        case 1:
+            ok = DecodeVersion1(data, scratch);
+            break;
+        case 2:
+            ok = DecodeTiles(data + 4, data + size, scratch);
+            break;
+        case 3:
+            ok = DecodeVersion3(data, size, scratch);
+            break;
+        default:
+            LogWarn("DecodeMap: map %d is not a map file version 1-%d",
+                    mapnum, MAPFILE_VERSION);
+            return false;
+    }
+
+    if (!ok) {
+        LogWarn("DecodeMap: map %d is damaged", mapnum);
+        return false;
+    }
+
+    scratch->num = mapnum;
+    memcpy(map, scratch, sizeof(*map));
+    return true;
+}
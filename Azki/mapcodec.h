@@ -0,0 +1,27 @@
+//
+//  mapcodec.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef mapcodec_h
+#define mapcodec_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+#include "cmdlib.h"
+
+#define MAPFILE_MAGIC       "AZM"   // followed by a version byte
+#define MAPFILE_VERSION     3       // version 1 is a bare mapdata_t
+#define MAPFILE_MAX         0x10000 // largest map file we'll read
+
+void InitMapCodec (void);
+size_t EncodeMap (const map_t *map, byte *out, size_t outsize);
+size_t EncodeMapVersion1 (const map_t *map, byte *out, size_t outsize);
+bool DecodeMap (const byte *data, size_t size, int mapnum, map_t *map);
+int MapFileVersion (const byte *data, size_t size);
+
+#endif /* mapcodec_h */
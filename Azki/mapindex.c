@@ -0,0 +1,735 @@
+//
+//  mapindex.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  An index of which object types are in which maps, for the editor's
+//  search. Each map has a posting per type and layer it contains: the
+//  number of tiles and the first INDEX_MAX_TILES positions. The maps are
+//  kept sorted by number, and a list per type of the postings that have
+//  it is rebuilt when something changes, so a query only looks at the
+//  maps that have the types it asks about.
+//
+//  The index is kept in INDEX_FILE with the crc of each map file it was
+//  built from. It's loaded when first needed, and only levels whose file
+//  no longer matches are scanned again; after that, saves and hot reloads
+//  update their map's entry.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "mapindex.h"
+#include "mapcodec.h"
+#include "levels.h"
+#include "writer.h"
+#include "jobs.h"
+#include "mem.h"
+#include "log.h"
+#include "cmdlib.h"
+
+#define MAX_TERMS       32
+
+typedef struct
+{
+    uint16_t    type;
+    uint8_t     layer;
+    uint8_t     numtiles;
+    uint16_t    count;
+    uint16_t    tiles[INDEX_MAX_TILES];
+} posting_t;
+
+typedef struct
+{
+    int         num;
+    uint32_t    crc;
+    int         numpostings;
+    posting_t * postings;   // by type, then layer
+} mapentry_t;
+
+typedef struct
+{
+    int         map;
+    int         posting;
+} indexref_t;
+
+typedef struct
+{
+    int             numlevels;
+    levelinfo_t **  levels;
+    mapentry_t *    results;
+    byte *          buffers;    // MAPFILE_MAX per thread
+    map_t *         maps;       // one per thread
+} scanrun_t;
+
+static mapentry_t * maps;       // sorted by num
+static int          nummaps;
+static int          maxmaps;
+
+// postings by type, in map order
+static indexref_t * refs;
+static int          typestart[NUMTYPES + 1];
+static bool         refsdirty = true;
+static bool         loaded;     // Index_Refresh has run
+
+// query scratch, one per map
+static uint32_t *   termbits;
+static indexmatch_t * scratch;
+
+
+
+#pragma mark - Entries
+
+static void FreeEntry (mapentry_t *entry)
+{
+    Mem_Free(entry->postings);
+    entry->postings = NULL;
+    entry->numpostings = 0;
+}
+
+
+static int FindMap (int num)
+{
+    int lo, hi, mid;
+
+    lo = 0;
+    hi = nummaps - 1;
+    while (lo <= hi)
+    {
+        mid = (lo + hi) / 2;
+        if (maps[mid].num == num)
+            return mid;
+        if (maps[mid].num < num)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -(lo + 1);
+}
+
+
+//
+//  SetEntry
+//  Replace or insert the entry for entry->num, which takes over its
+//  postings
+//
+static void SetEntry (mapentry_t *entry)
+{
+    int i;
+
+    i = FindMap(entry->num);
+    if (i >= 0)
+    {
+        FreeEntry(&maps[i]);
+        maps[i] = *entry;
+        refsdirty = true;
+        return;
+    }
+
+    if (nummaps == maxmaps)
+    {
+        maxmaps = maxmaps ? maxmaps * 2 : 128;
+        maps = Mem_Realloc(MEM_EDITOR, maps, maxmaps * sizeof(*maps));
+        termbits = Mem_Realloc(MEM_EDITOR, termbits, maxmaps * sizeof(*termbits));
+        scratch = Mem_Realloc(MEM_EDITOR, scratch, maxmaps * sizeof(*scratch));
+        if (!maps || !termbits || !scratch)
+            Quit("Index: out of memory");
+    }
+
+    i = -i - 1;
+    memmove(&maps[i + 1], &maps[i], (nummaps - i) * sizeof(*maps));
+    maps[i] = *entry;
+    nummaps++;
+    refsdirty = true;
+}
+
+
+static void RemoveEntry (int i)
+{
+    FreeEntry(&maps[i]);
+    memmove(&maps[i], &maps[i + 1], (nummaps - i - 1) * sizeof(*maps));
+    nummaps--;
+    refsdirty = true;
+}
+
+
+//
+//  BuildEntry
+//  Index a decoded map. Safe to call from any thread.
+//
+static bool BuildEntry (const map_t *map, uint32_t crc, mapentry_t *entry)
+{
+    uint16_t        counts[2][NUMTYPES];
+    const obj_t *   obj;
+    posting_t *     post;
+    int             layer, type, i;
+
+    memset(counts, 0, sizeof(counts));
+    for (layer=0 ; layer<2 ; layer++)
+    {
+        obj = layer ? &map->background[0][0] : &map->foreground[0][0];
+        for (i=0 ; i<MAP_W*MAP_H ; i++, obj++)
+            if (obj->type != TYPE_NONE && obj->type < NUMTYPES)
+                counts[layer][obj->type]++;
+    }
+
+    entry->num = map->num;
+    entry->crc = crc;
+    entry->numpostings = 0;
+    for (type=1 ; type<NUMTYPES ; type++)
+        for (layer=0 ; layer<2 ; layer++)
+            if (counts[layer][type])
+                entry->numpostings++;
+
+    entry->postings = NULL;
+    if (!entry->numpostings)
+        return true;
+    entry->postings = Mem_Alloc(MEM_EDITOR, entry->numpostings * sizeof(*entry->postings));
+    if (!entry->postings)
+        return false;
+
+    // postings in type order, then fill in the positions
+    post = entry->postings;
+    for (type=1 ; type<NUMTYPES ; type++)
+    {
+        for (layer=0 ; layer<2 ; layer++)
+        {
+            if (!counts[layer][type])
+                continue;
+            post->type = type;
+            post->layer = layer;
+            post->count = counts[layer][type];
+            post->numtiles = 0;
+            counts[layer][type] = post - entry->postings + 1;
+            post++;
+        }
+    }
+
+    for (layer=0 ; layer<2 ; layer++)
+    {
+        obj = layer ? &map->background[0][0] : &map->foreground[0][0];
+        for (i=0 ; i<MAP_W*MAP_H ; i++, obj++)
+        {
+            if (obj->type == TYPE_NONE || obj->type >= NUMTYPES)
+                continue;
+            post = &entry->postings[counts[layer][obj->type] - 1];
+            if (post->numtiles < INDEX_MAX_TILES)
+                post->tiles[post->numtiles++] = INDEX_TILE(layer, i % MAP_W, i / MAP_W);
+        }
+    }
+
+    return true;
+}
+
+
+//
+//  BuildRefs
+//  Rebuild the per-type lists of postings
+//
+static void BuildRefs (void)
+{
+    const posting_t *post;
+    int fill[NUMTYPES];
+    int i, j, total;
+
+    memset(typestart, 0, sizeof(typestart));
+    total = 0;
+    for (i=0 ; i<nummaps ; i++)
+    {
+        for (j=0 ; j<maps[i].numpostings ; j++)
+            typestart[maps[i].postings[j].type + 1]++;
+        total += maps[i].numpostings;
+    }
+    for (i=0 ; i<NUMTYPES ; i++)
+        typestart[i + 1] += typestart[i];
+
+    Mem_Free(refs);
+    refs = Mem_Alloc(MEM_EDITOR, (total ? total : 1) * sizeof(*refs));
+    if (!refs)
+        Quit("Index: out of memory");
+
+    memcpy(fill, typestart, sizeof(fill));
+    for (i=0 ; i<nummaps ; i++)
+    {
+        for (j=0, post=maps[i].postings ; j<maps[i].numpostings ; j++, post++)
+        {
+            refs[fill[post->type]].map = i;
+            refs[fill[post->type]].posting = j;
+            fill[post->type]++;
+        }
+    }
+
+    refsdirty = false;
+}
+
+
+
+#pragma mark - File
+
+static void PutU16 (byte *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void PutU32 (byte *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint16_t GetU16 (const byte *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t GetU32 (const byte *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+//
+//  WriteIndex
+//  "AZIX", version, map count, then per map: num, crc, posting count
+//  and per posting: type, layer, count, position count, positions.
+//  All little endian.
+//
+static void WriteIndex (void)
+{
+    const mapentry_t *  entry;
+    const posting_t *   post;
+    byte *              data;
+    byte *              p;
+    size_t              size;
+    int                 i, j, k;
+
+    size = 12;
+    for (i=0, entry=maps ; i<nummaps ; i++, entry++)
+    {
+        size += 10;
+        for (j=0, post=entry->postings ; j<entry->numpostings ; j++, post++)
+            size += 6 + post->numtiles * 2;
+    }
+
+    data = Mem_Alloc(MEM_EDITOR, size);
+    if (!data) {
+        LogError("WriteIndex: out of memory");
+        return;
+    }
+
+    memcpy(data, INDEX_MAGIC, 4);
+    PutU32(data + 4, INDEX_VERSION);
+    PutU32(data + 8, nummaps);
+    p = data + 12;
+    for (i=0, entry=maps ; i<nummaps ; i++, entry++)
+    {
+        PutU32(p, entry->num);
+        PutU32(p + 4, entry->crc);
+        PutU16(p + 8, entry->numpostings);
+        p += 10;
+        for (j=0, post=entry->postings ; j<entry->numpostings ; j++, post++)
+        {
+            PutU16(p, post->type);
+            p[2] = post->layer;
+            PutU16(p + 3, post->count);
+            p[5] = post->numtiles;
+            p += 6;
+            for (k=0 ; k<post->numtiles ; k++, p+=2)
+                PutU16(p, post->tiles[k]);
+        }
+    }
+
+    Writer_Replace(INDEX_FILE, data, size);
+    Mem_Free(data);
+}
+
+
+//
+//  ParseIndex
+//  Returns false if data isn't a whole index, keeping what was read
+//
+static bool ParseIndex (const byte *data, size_t size)
+{
+    const byte *    p;
+    const byte *    end;
+    mapentry_t      entry;
+    posting_t *     post;
+    uint32_t        count;
+    int             i, j, k;
+
+    if (size < 12 || memcmp(data, INDEX_MAGIC, 4) || GetU32(data + 4) != INDEX_VERSION)
+        return false;
+
+    count = GetU32(data + 8);
+    p = data + 12;
+    end = data + size;
+    for (i=0 ; i<count ; i++)
+    {
+        if (end - p < 10)
+            return false;
+        entry.num = GetU32(p);
+        entry.crc = GetU32(p + 4);
+        entry.numpostings = GetU16(p + 8);
+        p += 10;
+
+        entry.postings = Mem_Calloc(MEM_EDITOR, entry.numpostings ? entry.numpostings : 1, sizeof(*entry.postings));
+        if (!entry.postings)
+            return false;
+        for (j=0, post=entry.postings ; j<entry.numpostings ; j++, post++)
+        {
+            if (end - p < 6)
+                break;
+            post->type = GetU16(p);
+            post->layer = p[2];
+            post->count = GetU16(p + 3);
+            post->numtiles = p[5];
+            p += 6;
+            if (post->type == TYPE_NONE || post->type >= NUMTYPES || post->layer > 1
+                || post->numtiles > INDEX_MAX_TILES || end - p < post->numtiles * 2)
+                break;
+            for (k=0 ; k<post->numtiles ; k++, p+=2)
+                post->tiles[k] = GetU16(p);
+        }
+        if (j < entry.numpostings) {
+            FreeEntry(&entry);
+            return false;
+        }
+        SetEntry(&entry);
+    }
+
+    return p == end;
+}
+
+
+static void ReadIndex (void)
+{
+    FILE *  file;
+    byte *  data;
+    long    size;
+
+    file = fopen(INDEX_FILE, "rb");
+    if (!file)
+        return;
+
+    data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0)
+    {
+        data = Mem_Alloc(MEM_EDITOR, size);
+        rewind(file);
+        if (data && fread(data, size, 1, file) == 1 && !ParseIndex(data, size))
+        {
+            LogWarn("ReadIndex: %s is damaged, rebuilding it", INDEX_FILE);
+            while (nummaps)
+                RemoveEntry(nummaps - 1);
+        }
+    }
+
+    Mem_Free(data);
+    fclose(file);
+}
+
+
+
+#pragma mark - Scanning
+
+static void ScanJob (int job, int thread, void *data)
+{
+    scanrun_t *     run;
+    levelinfo_t *   info;
+    mapentry_t *    result;
+    const byte *    file;
+    size_t          size;
+
+    run = data;
+    info = run->levels[job];
+    result = &run->results[job];
+    result->num = 0; // couldn't index
+
+    file = ReadMapFile(info->num, run->buffers + (size_t)thread * MAPFILE_MAX, &size);
+    if (!file || !DecodeMap(file, size, info->num, &run->maps[thread]))
+        return;
+
+    if (!BuildEntry(&run->maps[thread], CRC32(file, size), result))
+        result->num = 0;
+}
+
+
+//
+//  Index_Refresh
+//  Load the index and scan the levels it doesn't match. Done by the
+//  first query if not before.
+//
+void Index_Refresh (void)
+{
+    scanrun_t       run;
+    levelinfo_t *   list;
+    int             count, i, j, numthreads, indexed, dropped;
+    Uint64          start;
+    bool            found;
+
+    start = SDL_GetPerformanceCounter();
+    if (!loaded)
+        ReadIndex();
+    loaded = true;
+
+    // maps no longer in the manifest
+    list = LevelList(&count);
+    dropped = 0;
+    for (i=nummaps-1 ; i>=0 ; i--)
+    {
+        found = false;
+        for (j=0 ; j<count && !found ; j++)
+            found = list[j].num == maps[i].num;
+        if (!found) {
+            RemoveEntry(i);
+            dropped++;
+        }
+    }
+
+    // and those that changed since they were indexed
+    run.levels = Mem_Alloc(MEM_EDITOR, (count ? count : 1) * sizeof(*run.levels));
+    if (!run.levels)
+        Quit("Index_Refresh: out of memory");
+    run.numlevels = 0;
+    for (i=0 ; i<count ; i++)
+    {
+        j = FindMap(list[i].num);
+        if (j < 0 || !list[i].size || maps[j].crc != list[i].crc)
+            run.levels[run.numlevels++] = &list[i];
+    }
+
+    indexed = 0;
+    if (run.numlevels)
+    {
+        numthreads = Jobs_DefaultThreads();
+        if (numthreads > run.numlevels)
+            numthreads = run.numlevels;
+        run.results = Mem_Alloc(MEM_EDITOR, run.numlevels * sizeof(*run.results));
+        run.buffers = Mem_Alloc(MEM_EDITOR, (size_t)numthreads * MAPFILE_MAX);
+        run.maps = Mem_Alloc(MEM_EDITOR, numthreads * sizeof(*run.maps));
+        if (!run.results || !run.buffers || !run.maps)
+            Quit("Index_Refresh: out of memory");
+
+        Jobs_Run(ScanJob, run.numlevels, &run, numthreads);
+
+        for (i=0 ; i<run.numlevels ; i++)
+        {
+            if (run.results[i].num) {
+                SetEntry(&run.results[i]);
+                indexed++;
+            } else if ((j = FindMap(run.levels[i]->num)) >= 0) {
+                RemoveEntry(j); // it's out of date
+            }
+        }
+
+        Mem_Free(run.results);
+        Mem_Free(run.buffers);
+        Mem_Free(run.maps);
+    }
+    Mem_Free(run.levels);
+
+    if (indexed || dropped || run.numlevels)
+        WriteIndex();
+
+    LogInfo("Index_Refresh: %d maps, %d indexed, %d dropped, %.1f ms",
+            nummaps, indexed, dropped,
+            (SDL_GetPerformanceCounter() - start) * 1000.0
+            / SDL_GetPerformanceFrequency());
+}
+
+
+//
+//  Index_UpdateMap
+//  map was saved or changed on disk as a file with the given crc
+//
+void Index_UpdateMap (const map_t *map, uint32_t crc)
+{
+    mapentry_t entry;
+    int i;
+
+    if (!loaded)
+        return; // it'll be scanned when it is
+
+    i = FindMap(map->num);
+    if (i >= 0 && maps[i].crc == crc)
+        return;
+
+    if (!BuildEntry(map, crc, &entry)) {
+        LogError("Index_UpdateMap: out of memory");
+        return;
+    }
+    SetEntry(&entry);
+    WriteIndex();
+}
+
+
+//
+//  Index_AddMap
+//  Index map in memory only, for tools that build an index from maps
+//  outside the level list. Queries then search just the maps added.
+//
+bool Index_AddMap (const map_t *map, uint32_t crc)
+{
+    mapentry_t entry;
+
+    loaded = true;
+    if (!BuildEntry(map, crc, &entry))
+        return false;
+    SetEntry(&entry);
+    return true;
+}
+
+
+int Index_NumMaps (void)
+{
+    return nummaps;
+}
+
+
+
+#pragma mark - Queries
+
+static bool ContainsNoCase (const char *s, const char *sub, size_t sublen)
+{
+    size_t i;
+
+    for ( ; *s ; s++)
+    {
+        for (i=0 ; i<sublen && s[i] ; i++)
+            if (tolower((unsigned char)s[i]) != tolower((unsigned char)sub[i]))
+                break;
+        if (i == sublen)
+            return true;
+    }
+    return false;
+}
+
+
+//
+//  MatchTypes
+//  Mark the types whose name contains the term, returns how many
+//
+static int MatchTypes (const char *term, size_t len, bool types[NUMTYPES])
+{
+    int type, count;
+
+    count = 0;
+    for (type=1 ; type<NUMTYPES ; type++)
+    {
+        types[type] = objdefs[type].name[0] && ContainsNoCase(objdefs[type].name, term, len);
+        count += types[type];
+    }
+    return count;
+}
+
+
+//
+//  Index_Query
+//  Find the maps with objects named by each term in query, e.g.
+//  "spider, key, -door": terms are separated by commas, name part of an
+//  object name and can be negated with '-'. Matches are in map order, with
+//  the count and positions of the first term's objects. Returns the
+//  number of matches, or -1 with *error set if the query is no good.
+//
+int Index_Query (const char *query, indexmatch_t *matches, int maxmatches, const char **error)
+{
+    static char     message[80];
+    bool            types[NUMTYPES];
+    const char *    term;
+    const char *    end;
+    const posting_t * post;
+    indexmatch_t *  match;
+    uint32_t        needed, excluded, bit;
+    size_t          len;
+    int             numterms, type, i, count;
+    bool            negate, first;
+
+    *error = NULL;
+    if (!loaded)
+        Index_Refresh();
+    if (refsdirty)
+        BuildRefs();
+    if (nummaps)
+        memset(termbits, 0, nummaps * sizeof(*termbits));
+
+    needed = excluded = 0;
+    numterms = 0;
+    for (term=query ; *term ; term=end)
+    {
+        while (*term == ',' || isspace((unsigned char)*term))
+            term++;
+        negate = *term == '-';
+        if (negate)
+            term++;
+        for (end=term ; *end && *end != ',' ; end++)
+            ;
+        for (len=end-term ; len && isspace((unsigned char)term[len - 1]) ; len--)
+            ;
+        if (!len)
+            continue;
+
+        if (numterms == MAX_TERMS) {
+            *error = "too many terms";
+            return -1;
+        }
+        if (!MatchTypes(term, len, types)) {
+            snprintf(message, sizeof(message), "no object named '%.*s'", (int)len, term);
+            *error = message;
+            return -1;
+        }
+
+        bit = 1u << numterms;
+        if (negate)
+            excluded |= bit;
+        else
+            needed |= bit;
+        first = needed == bit && !negate;
+
+        for (type=1 ; type<NUMTYPES ; type++)
+        {
+            if (!types[type])
+                continue;
+            for (i=typestart[type] ; i<typestart[type + 1] ; i++)
+            {
+                match = &scratch[refs[i].map];
+                if (first) // counts and positions
+                {
+                    if (!(termbits[refs[i].map] & bit)) {
+                        match->count = 0;
+                        match->numtiles = 0;
+                    }
+                    post = &maps[refs[i].map].postings[refs[i].posting];
+                    match->count += post->count;
+                    for (count=0 ; count<post->numtiles && match->numtiles<INDEX_MAX_TILES ; count++)
+                        match->tiles[match->numtiles++] = post->tiles[count];
+                }
+                termbits[refs[i].map] |= bit;
+            }
+        }
+        numterms++;
+    }
+
+    if (!needed) {
+        *error = numterms ? "nothing to look for, only '-' terms" : "nothing to look for";
+        return -1;
+    }
+
+    count = 0;
+    for (i=0 ; i<nummaps && count<maxmatches ; i++)
+    {
+        if ((termbits[i] & needed) != needed || (termbits[i] & excluded))
+            continue;
+        matches[count] = scratch[i];
+        matches[count].mapnum = maps[i].num;
+        count++;
+    }
+
+    return count;
+}
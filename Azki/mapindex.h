@@ -0,0 +1,41 @@
+//
+//  mapindex.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef mapindex_h
+#define mapindex_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map.h"
+
+#define INDEX_FILE          "maps/index.dat"
+#define INDEX_MAGIC         "AZIX"
+#define INDEX_VERSION       1
+#define INDEX_MAX_TILES     32      // positions kept per map, type and layer
+
+// an index tile: layer in the top bit, then y * MAP_W + x
+#define INDEX_TILE(layer, x, y) ((layer) << 15 | ((y) * MAP_W + (x)))
+#define INDEX_LAYER(t)          ((t) >> 15)
+#define INDEX_X(t)              (((t) & 0x7FFF) % MAP_W)
+#define INDEX_Y(t)              (((t) & 0x7FFF) / MAP_W)
+
+typedef struct
+{
+    int         mapnum;
+    int         count;      // tiles of the first term's types
+    int         numtiles;
+    uint16_t    tiles[INDEX_MAX_TILES];
+} indexmatch_t;
+
+void Index_Refresh (void);
+void Index_UpdateMap (const map_t *map, uint32_t crc);
+bool Index_AddMap (const map_t *map, uint32_t crc);
+int  Index_NumMaps (void);
+int  Index_Query (const char *query, indexmatch_t *matches, int maxmatches, const char **error);
+
+#endif /* mapindex_h */
@@ -0,0 +1,1249 @@
+//
+//  maptool.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  azki-maptool: check, convert and measure a whole level set offline.
+//  Built from the game's sources (all but main.c), so maps are read and
+//  judged exactly as the game would. Every map is an independent job on
+//  the job threads; results are kept per map and reported in order once
+//  all are done.
+//
+//  azki-maptool -check <dir|pack>
+//  azki-maptool -stats <dir|pack> [-json out.json]
+//  azki-maptool -convert <dir|pack> <outdir> [-format 1|3]
+//  azki-maptool -generate <count> <outdir>
+//  azki-maptool -render <dir|pack> <outdir> [-scale N] [-png store|fast]
+//  azki-maptool -thumbs <dir|pack> <outdir> [-png store|fast]
+//  azki-maptool -bot <dir|pack> [-sessions N] [-ticks N] [-seed N]
+//  azki-maptool -query <dir|pack> <query> [-repeat N]
+//
+//  options: -threads N (default: one per CPU), -log file
+//
+//  Thumbnails are made at each THUMB_FACTORS reduction from one render
+//  of the map. The map checksums they were made from are kept in
+//  outdir/THUMB_CACHE, and maps that haven't changed are skipped.
+//
+//  -bot has the autoplay bot play each map -sessions times, seeds -seed
+//  on up, and totals how the sessions ended, what killed the bot and
+//  what a tick cost. The game's state is global, so sessions run as
+//  processes rather than job threads, -threads of them at a time.
+//
+//  -query indexes every map the way the editor's search does, then times
+//  the query -repeat times over it, e.g. "spider, -nessie" over a -generate
+//  set. The first query also builds the index's lookup tables.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <SDL2/SDL.h>
+
+#include "azki.h"
+#include "map.h"
+#include "mapcodec.h"
+#include "pack.h"
+#include "jobs.h"
+#include "image.h"
+#include "png.h"
+#include "bot.h"
+#include "mem.h"
+#include "mapindex.h"
+#include "cmdlib.h"
+#include "log.h"
+
+#define TOOL_PATH_LEN   256
+#define QUERY_MATCHES   64
+#define MAX_MESSAGES    8
+#define MESSAGE_LEN     96
+
+#define THUMB_CACHE     "thumbs.cache"
+#define THUMB_VERSION   1       // bump when thumbnails are drawn differently
+#define THUMB_FACTORS   { 2, 4 }
+#define NUM_THUMBS      2
+
+#define MAX_CAUSES      8       // death causes listed per map
+
+typedef struct
+{
+    char        file[TOOL_PATH_LEN];
+    int         num;
+    const byte *packdata;   // NULL for loose files
+    size_t      packsize;
+
+    // results
+    bool        loaded;
+    int         version;
+    size_t      size;
+    uint32_t    crc;
+    bool        cached;         // thumbnail cache has an entry
+    uint32_t    cachedcrc;
+    bool        uptodate;       // thumbnails made now or before
+    int         counts[2][NUMTYPES];    // foreground, background
+    int         solid;                  // solid foreground tiles
+    int         numerrors;
+    int         numwarnings;
+    int         nummessages;
+    char        messages[MAX_MESSAGES][MESSAGE_LEN];
+} mapjob_t;
+
+static mapjob_t *   jobs;
+static int          numjobs;
+static int          maxjobs;
+
+static map_t *      scratchmaps[MAX_JOB_THREADS];
+static byte *       scratchdata[MAX_JOB_THREADS];
+
+static const char * outdir;
+static int          outformat = MAPFILE_VERSION;
+static pngmode_t    pngmode = PNG_FAST;
+static int          renderscale = 1;
+
+static botresult_t *botresults;     // sessions of each job, shared with their processes
+static int          botsessions = 16;
+static int          botticks = BOT_TICKS;
+static int          queryrepeat = 1000;
+static uint64_t     botseed = 1;
+
+// the game's globals that the shared sources expect
+const uint8_t * keys;
+
+
+
+void Quit (const char * error)
+{
+    fflush(stdout);
+    Pack_Close();
+    Log_Shutdown();
+    if (error && *error) {
+        fprintf(stderr, "azki-maptool: %s\n", error);
+        exit(1);
+    }
+    exit(0);
+}
+
+
+
+#pragma mark - Finding Maps
+
+static mapjob_t *NewJob (void)
+{
+    if (numjobs == maxjobs)
+    {
+        maxjobs = maxjobs ? maxjobs * 2 : 256;
+        jobs = Mem_Realloc(MEM_MISC, jobs, maxjobs * sizeof(*jobs));
+        if (!jobs)
+            Quit("could not alloc jobs");
+    }
+    memset(&jobs[numjobs], 0, sizeof(*jobs));
+    return &jobs[numjobs++];
+}
+
+
+static int CompareJobs (const void *a, const void *b)
+{
+    const mapjob_t *ja = a;
+    const mapjob_t *jb = b;
+
+    if (ja->num != jb->num)
+        return ja->num < jb->num ? -1 : 1;
+    return strcmp(ja->file, jb->file);
+}
+
+
+//
+//  MakeOutDir
+//  Create outdir if it isn't there, before any job writes to it
+//
+static void MakeOutDir (void)
+{
+    struct stat st;
+
+    if (stat(outdir, &st) == 0)
+    {
+        if (!S_ISDIR(st.st_mode))
+            Quit("output is not a directory");
+        return;
+    }
+    if (mkdir(outdir, 0777) != 0)
+        Quit("couldn't create the output directory");
+}
+
+
+//
+//  FindMaps
+//  Make a job for every map in a directory of map files, or in a pack
+//
+static void FindMaps (const char *path)
+{
+    const packentry_t * entry;
+    struct dirent *     ent;
+    struct stat         st;
+    mapjob_t *          job;
+    size_t              len;
+    DIR *               dir;
+    int                 i;
+
+    if (stat(path, &st) != 0)
+        Quit("no such directory or pack");
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        if (!Pack_Open(path))
+            Quit("not a map pack");
+        for (i=0 ; i<Pack_NumLevels() ; i++)
+        {
+            entry = Pack_Entry(i);
+            job = NewJob();
+            snprintf(job->file, sizeof(job->file), "%s:%d", path, entry->num);
+            job->num = entry->num;
+            job->packdata = Pack_LevelData(entry);
+            job->packsize = entry->size;
+        }
+        qsort(jobs, numjobs, sizeof(*jobs), CompareJobs);
+        return;
+    }
+
+    dir = opendir(path);
+    if (!dir)
+        Quit("could not open directory");
+    while ((ent = readdir(dir)) != NULL)
+    {
+        len = strlen(ent->d_name);
+        if (len < 5 || strcmp(ent->d_name + len - 4, ".map"))
+            continue;
+
+        job = NewJob();
+        snprintf(job->file, sizeof(job->file), "%s/%s", path, ent->d_name);
+        if (sscanf(ent->d_name, "%d.map", &job->num) != 1)
+            job->num = 0;
+    }
+    closedir(dir);
+
+    qsort(jobs, numjobs, sizeof(*jobs), CompareJobs);
+}
+
+
+
+#pragma mark - Jobs
+
+static void AddMessage (mapjob_t *job, bool error, const char *fmt, ...)
+{
+    va_list argptr;
+    char *msg;
+
+    if (error)
+        job->numerrors++;
+    else
+        job->numwarnings++;
+    if (job->nummessages == MAX_MESSAGES)
+        return;
+
+    msg = job->messages[job->nummessages++];
+    strcpy(msg, error ? "error: " : "warning: ");
+    va_start(argptr, fmt);
+    vsnprintf(msg + strlen(msg), MESSAGE_LEN - strlen(msg), fmt, argptr);
+    va_end(argptr);
+}
+
+
+//
+//  ReadJobData
+//  Get a job's map file, read into the thread's scratch buffer if loose
+//
+static const byte *ReadJobData (mapjob_t *job, int thread)
+{
+    const byte *data;
+    FILE *file;
+
+    if (job->packdata)
+    {
+        data = job->packdata;
+        job->size = job->packsize;
+    }
+    else
+    {
+        file = fopen(job->file, "rb");
+        if (!file) {
+            AddMessage(job, true, "can't open file");
+            return NULL;
+        }
+        data = scratchdata[thread];
+        job->size = fread(scratchdata[thread], 1, MAPFILE_MAX, file);
+        fclose(file);
+    }
+
+    job->crc = CRC32(data, job->size);
+    return data;
+}
+
+
+static map_t *DecodeJobMap (mapjob_t *job, const byte *data, int thread)
+{
+    map_t *map;
+
+    map = scratchmaps[thread];
+    job->version = MapFileVersion(data, job->size);
+    if (!DecodeMap(data, job->size, job->num, map)) {
+        AddMessage(job, true, "not a map, or damaged (version %d)", job->version);
+        return NULL;
+    }
+
+    job->loaded = true;
+    return map;
+}
+
+
+static map_t *LoadJobMap (mapjob_t *job, int thread)
+{
+    const byte *data;
+
+    data = ReadJobData(job, thread);
+    return data ? DecodeJobMap(job, data, thread) : NULL;
+}
+
+
+static void CheckKeys (mapjob_t *job, objtype_t key, objtype_t door)
+{
+    int numkeys, numdoors;
+
+    numkeys = job->counts[0][key];
+    numdoors = job->counts[0][door];
+    if (numdoors && !numkeys)
+        AddMessage(job, true, "%d %s but no %s", numdoors, objdefs[door].name, objdefs[key].name);
+    else if (numkeys && !numdoors)
+        AddMessage(job, false, "%s but no %s", objdefs[key].name, objdefs[door].name);
+}
+
+
+//
+//  CheckMap
+//  Count everything on the map and check it's playable
+//
+static void CheckMap (mapjob_t *job, const map_t *map)
+{
+    const obj_t *obj;
+    int x, y;
+
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        for (x=0 ; x<MAP_W ; x++)
+        {
+            obj = &map->foreground[y][x];
+            job->counts[0][obj->type]++;
+            if ((obj->flags & OF_SOLID) && !(obj->flags & OF_ENTITY))
+                job->solid++;
+
+            obj = &map->background[y][x];
+            job->counts[1][obj->type]++;
+            if (obj->flags & OF_ENTITY)
+                AddMessage(job, true, "%s on the background at %d,%d", objdefs[obj->type].name, x, y);
+        }
+    }
+
+    if (job->counts[0][TYPE_PLAYER] != 1)
+        AddMessage(job, true, "%d player starts", job->counts[0][TYPE_PLAYER]);
+    if (!job->counts[0][TYPE_EXIT])
+        AddMessage(job, true, "no exit");
+
+    CheckKeys(job, TYPE_GOLDKEY, TYPE_GOLDDOOR);
+    CheckKeys(job, TYPE_BLUEKEY, TYPE_BLUEDOOR);
+    CheckKeys(job, TYPE_GREENKEY, TYPE_GREENDOOR);
+}
+
+
+static bool WriteJobMap (mapjob_t *job, const map_t *map, int thread)
+{
+    char path[TOOL_PATH_LEN];
+    FILE *file;
+    size_t size;
+    bool ok;
+
+    if (outformat == 1)
+        size = EncodeMapVersion1(map, scratchdata[thread], MAPFILE_MAX);
+    else
+        size = EncodeMap(map, scratchdata[thread], MAPFILE_MAX);
+    if (!size) {
+        AddMessage(job, true, "couldn't encode");
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "%s/%d.map", outdir, map->num);
+    file = fopen(path, "wb");
+    ok = file && fwrite(scratchdata[thread], size, 1, file) == 1;
+    if (file && fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        AddMessage(job, true, "couldn't write %s", path);
+
+    return ok;
+}
+
+
+static void CheckJob (int index, int thread, void *data)
+{
+    mapjob_t *job;
+    map_t *map;
+
+    job = &jobs[index];
+    map = LoadJobMap(job, thread);
+    if (map)
+        CheckMap(job, map);
+}
+
+
+static void ConvertJob (int index, int thread, void *data)
+{
+    mapjob_t *job;
+    map_t *map;
+
+    job = &jobs[index];
+    map = LoadJobMap(job, thread);
+    if (!map)
+        return;
+
+    if (!job->num) {
+        AddMessage(job, true, "no map number in the file name, not converted");
+        return;
+    }
+    CheckMap(job, map);
+    WriteJobMap(job, map, thread);
+}
+
+
+static void RenderJob (int index, int thread, void *data)
+{
+    char        path[TOOL_PATH_LEN];
+    mapjob_t *  job;
+    map_t *     map;
+    image_t     img, big;
+
+    job = &jobs[index];
+    map = LoadJobMap(job, thread);
+    if (!map)
+        return;
+    if (!job->num) {
+        AddMessage(job, true, "no map number in the file name, not rendered");
+        return;
+    }
+
+    if (!Image_Alloc(&img, MAP_W * TILE_SIZE, MAP_H * TILE_SIZE))
+        Quit("could not alloc image");
+    Image_DrawMap(&img, map);
+    if (renderscale > 1)
+    {
+        if (!Image_Enlarge(&img, &big, renderscale))
+            Quit("could not alloc image");
+        Image_Free(&img);
+        img = big;
+    }
+
+    snprintf(path, sizeof(path), "%s/%d.png", outdir, job->num);
+    if (!PNG_Write(path, &img, pngmode))
+        AddMessage(job, true, "couldn't write %s", path);
+    Image_Free(&img);
+}
+
+
+
+#pragma mark - Thumbnails
+
+static void ThumbPath (char *path, const mapjob_t *job, int factor)
+{
+    snprintf(path, TOOL_PATH_LEN, "%s/%d-%d.png", outdir, job->num,
+             MAP_W * TILE_SIZE / factor);
+}
+
+
+static bool ThumbsExist (const mapjob_t *job)
+{
+    static const int factors[NUM_THUMBS] = THUMB_FACTORS;
+    char path[TOOL_PATH_LEN];
+    struct stat st;
+    int i;
+
+    for (i=0 ; i<NUM_THUMBS ; i++)
+    {
+        ThumbPath(path, job, factors[i]);
+        if (stat(path, &st) != 0)
+            return false;
+    }
+    return true;
+}
+
+
+static void ThumbJob (int index, int thread, void *data)
+{
+    static const int factors[NUM_THUMBS] = THUMB_FACTORS;
+    char        path[TOOL_PATH_LEN];
+    const byte *mapdata;
+    mapjob_t *  job;
+    map_t *     map;
+    image_t     img, thumb;
+    int         i;
+
+    job = &jobs[index];
+    if (!job->num) {
+        AddMessage(job, true, "no map number in the file name, no thumbnails");
+        return;
+    }
+
+    mapdata = ReadJobData(job, thread);
+    if (!mapdata)
+        return;
+    if (job->cached && job->cachedcrc == job->crc && ThumbsExist(job)) {
+        job->uptodate = true;
+        return;
+    }
+
+    map = DecodeJobMap(job, mapdata, thread);
+    if (!map)
+        return;
+
+    if (!Image_Alloc(&img, MAP_W * TILE_SIZE, MAP_H * TILE_SIZE))
+        Quit("could not alloc image");
+    Image_DrawMap(&img, map);
+
+    job->uptodate = true;
+    for (i=0 ; i<NUM_THUMBS ; i++)
+    {
+        if (!Image_Shrink(&img, &thumb, factors[i]))
+            Quit("could not alloc image");
+        ThumbPath(path, job, factors[i]);
+        if (!PNG_Write(path, &thumb, pngmode)) {
+            AddMessage(job, true, "couldn't write %s", path);
+            job->uptodate = false;
+        }
+        Image_Free(&thumb);
+    }
+    Image_Free(&img);
+}
+
+
+static int CompareJobNum (const void *key, const void *elem)
+{
+    int num = *(const int *)key;
+    const mapjob_t *job = elem;
+
+    return num < job->num ? -1 : num > job->num;
+}
+
+
+//
+//  ReadThumbCache
+//  Mark the jobs that had thumbnails made, and from what
+//
+static void ReadThumbCache (void)
+{
+    char        path[TOOL_PATH_LEN];
+    mapjob_t *  job;
+    FILE *      file;
+    unsigned    crc;
+    int         num, version;
+
+    snprintf(path, sizeof(path), "%s/%s", outdir, THUMB_CACHE);
+    file = fopen(path, "r");
+    if (!file)
+        return;
+
+    if (fscanf(file, "azki-thumbs %d", &version) == 1 && version == THUMB_VERSION)
+    {
+        while (fscanf(file, "%d %x", &num, &crc) == 2)
+        {
+            job = bsearch(&num, jobs, numjobs, sizeof(*jobs), CompareJobNum);
+            if (job) {
+                job->cached = true;
+                job->cachedcrc = crc;
+            }
+        }
+    }
+    fclose(file);
+}
+
+
+static void WriteThumbCache (void)
+{
+    char    path[TOOL_PATH_LEN];
+    FILE *  file;
+    int     i, skipped;
+
+    snprintf(path, sizeof(path), "%s/%s", outdir, THUMB_CACHE);
+    file = fopen(path, "w");
+    if (!file)
+        Quit("could not write thumbnail cache");
+
+    skipped = 0;
+    fprintf(file, "azki-thumbs %d\n", THUMB_VERSION);
+    for (i=0 ; i<numjobs ; i++)
+    {
+        if (!jobs[i].uptodate)
+            continue;
+        fprintf(file, "%d %08x\n", jobs[i].num, jobs[i].crc);
+        if (!jobs[i].loaded)
+            skipped++;
+    }
+    fclose(file);
+
+    fprintf(stderr, "%d maps unchanged, thumbnails kept\n", skipped);
+}
+
+
+
+#pragma mark - Generating
+
+static uint32_t NextRandom (uint32_t *state)
+{
+    uint32_t x;
+
+    x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+
+static void PlaceRandom (map_t *map, objtype_t type, uint32_t *rng)
+{
+    int x, y;
+
+    do {
+        x = 1 + NextRandom(rng) % (MAP_W - 2);
+        y = 1 + NextRandom(rng) % (MAP_H - 2);
+    } while (map->foreground[y][x].type != TYPE_NONE);
+
+    map->foreground[y][x] = NewObjectFromDef(type, x, y);
+}
+
+
+//
+//  GenerateJob
+//  A random, valid map: walled in, some rocks and water, a player,
+//  an exit, a few monsters and maybe a locked door
+//
+static void GenerateJob (int index, int thread, void *data)
+{
+    static const objtype_t monsters[] = { TYPE_SPIDER, TYPE_NESSIE, TYPE_ORGE, TYPE_BLOB };
+    mapjob_t *  job;
+    map_t *     map;
+    uint32_t    rng;
+    objtype_t   type;
+    int         x, y, i, r;
+
+    job = &jobs[index];
+    map = scratchmaps[thread];
+    map->num = job->num;
+    rng = 0x9E3779B9u * (uint32_t)job->num | 1;
+
+    for (y=0 ; y<MAP_H ; y++)
+    {
+        for (x=0 ; x<MAP_W ; x++)
+        {
+            r = NextRandom(&rng) % 100;
+            type = TYPE_NONE;
+            if (x == 0 || y == 0 || x == MAP_W - 1 || y == MAP_H - 1)
+                type = TYPE_TREE;
+            else if (r < 12)
+                type = TYPE_STONE1 + r % 2;
+            else if (r < 16)
+                type = TYPE_ROCK1 + r % 4;
+            else if (r < 18)
+                type = TYPE_WATER;
+            map->foreground[y][x] = NewObjectFromDef(type, x, y);
+
+            type = r < 90 ? TYPE_GRASS1 + r % 4 : TYPE_DIRT;
+            map->background[y][x] = NewObjectFromDef(type, x, y);
+        }
+    }
+
+    PlaceRandom(map, TYPE_PLAYER, &rng);
+    PlaceRandom(map, TYPE_EXIT, &rng);
+    r = NextRandom(&rng) % 8;
+    for (i=0 ; i<r ; i++)
+        PlaceRandom(map, monsters[NextRandom(&rng) % 4], &rng);
+    if (NextRandom(&rng) % 2) {
+        PlaceRandom(map, TYPE_GOLDKEY, &rng);
+        PlaceRandom(map, TYPE_GOLDDOOR, &rng);
+    }
+
+    CheckMap(job, map);
+    WriteJobMap(job, map, thread);
+}
+
+
+
+#pragma mark - Bots
+
+//
+//  RunBots
+//  Play every map botsessions times, at most numthreads at once. Each
+//  session forks and writes its result to shared memory, so one that
+//  crashes is left BOT_CRASHED.
+//
+static void RunBots (int numthreads)
+{
+    uint64_t    start;
+    map_t *     level;
+    size_t      size;
+    pid_t       pid;
+    int         i, s, running;
+
+    size = (size_t)numjobs * botsessions * sizeof(*botresults);
+    botresults = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    if (botresults == MAP_FAILED)
+        Quit("could not map session results");
+    memset(botresults, 0, size);
+
+    scratchmaps[0] = Mem_Alloc(MEM_MAPS, sizeof(map_t));
+    scratchdata[0] = Mem_Alloc(MEM_MAPS, MAPFILE_MAX);
+    if (!scratchmaps[0] || !scratchdata[0])
+        Quit("could not alloc scratch buffers");
+
+    start = SDL_GetPerformanceCounter();
+    running = 0;
+    for (i=0 ; i<numjobs ; i++)
+    {
+        if (!(level = LoadJobMap(&jobs[i], 0)))
+            continue;
+
+        for (s=0 ; s<botsessions ; s++)
+        {
+            if (running == numthreads) {
+                wait(NULL);
+                running--;
+            }
+
+            fflush(stdout); // or the session gets a copy of what's buffered
+            fflush(stderr);
+            pid = fork();
+            if (pid == -1)
+                Quit("could not start a session");
+            if (pid == 0) {
+                Bot_Play(level, botseed + s, botticks, &botresults[i * botsessions + s]);
+                _exit(0);
+            }
+            running++;
+        }
+    }
+    for ( ; running ; running--)
+        wait(NULL);
+
+    fprintf(stderr, "%d maps, %d sessions, %.1f s on %d processes\n",
+            numjobs, numjobs * botsessions,
+            (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency(),
+            numthreads);
+
+    Mem_Free(scratchmaps[0]);
+    Mem_Free(scratchdata[0]);
+}
+
+
+
+#pragma mark - Reporting
+
+typedef struct
+{
+    char        cause[BOT_CAUSE_LEN];
+    int         count;
+} cause_t;
+
+
+static void CountCause (cause_t *causes, int *numcauses, int max, const char *cause)
+{
+    int i;
+
+    for (i=0 ; i<*numcauses ; i++)
+    {
+        if (!strcmp(causes[i].cause, cause)) {
+            causes[i].count++;
+            return;
+        }
+    }
+    if (*numcauses >= max) // "other" makes max + 1
+        cause = "other";
+    for (i=0 ; i<*numcauses ; i++)
+    {
+        if (!strcmp(causes[i].cause, cause)) {
+            causes[i].count++;
+            return;
+        }
+    }
+
+    strcpy(causes[*numcauses].cause, cause);
+    causes[(*numcauses)++].count = 1;
+}
+
+
+static int CompareCauses (const void *a, const void *b)
+{
+    return ((const cause_t *)b)->count - ((const cause_t *)a)->count;
+}
+
+
+static int CompareInts (const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+
+//
+//  PrintBots
+//  A line for each map and the death causes, then the totals
+//
+static void PrintBots (void)
+{
+    static const char * outcomes[] = { "crashed", "exited", "died", "timed out" };
+    const botresult_t * r;
+    cause_t             causes[MAX_CAUSES + 1];
+    cause_t             allcauses[MAX_CAUSES * 4 + 1];
+    int *               exitticks;
+    int                 counts[4], totals[4];
+    int                 numcauses, numallcauses, numexits;
+    double              tickus, maxtickus, alltickus;
+    int                 maxentities;
+    long                heapkept;
+    int                 i, s, played;
+
+    exitticks = Mem_Alloc(MEM_MISC, botsessions * sizeof(*exitticks));
+    if (!exitticks)
+        Quit("could not alloc results");
+
+    memset(totals, 0, sizeof(totals));
+    numallcauses = 0;
+    alltickus = 0;
+    played = 0;
+    for (i=0 ; i<numjobs ; i++)
+    {
+        if (!jobs[i].loaded)
+            continue;
+
+        memset(counts, 0, sizeof(counts));
+        numcauses = numexits = maxentities = 0;
+        heapkept = 0;
+        tickus = maxtickus = 0;
+        for (s=0 ; s<botsessions ; s++)
+        {
+            r = &botresults[i * botsessions + s];
+            counts[r->outcome]++;
+            totals[r->outcome]++;
+            if (r->outcome == BOT_EXITED)
+                exitticks[numexits++] = r->ticks;
+            if (r->outcome == BOT_DIED) {
+                CountCause(causes, &numcauses, MAX_CAUSES, r->cause);
+                CountCause(allcauses, &numallcauses, MAX_CAUSES * 4, r->cause);
+            }
+            tickus += r->tickus;
+            if (r->maxtickus > maxtickus)
+                maxtickus = r->maxtickus;
+            if (r->maxentities > maxentities)
+                maxentities = r->maxentities;
+            if (r->heapkept > heapkept)
+                heapkept = r->heapkept;
+        }
+        tickus /= botsessions;
+        alltickus += tickus;
+        played++;
+
+        printf("%s: %d exited", jobs[i].file, counts[BOT_EXITED]);
+        if (numexits) {
+            qsort(exitticks, numexits, sizeof(*exitticks), CompareInts);
+            printf(" (median %d ticks)", exitticks[numexits / 2]);
+        }
+        printf(", %d died, %d timed out, %d crashed, %.2f us/tick (max %.1f), %d entities\n",
+               counts[BOT_DIED], counts[BOT_TIMEOUT], counts[BOT_CRASHED],
+               tickus, maxtickus, maxentities);
+        if (heapkept)
+            printf("    up to %ld heap bytes kept after a session\n", heapkept);
+
+        qsort(causes, numcauses, sizeof(*causes), CompareCauses);
+        for (s=0 ; s<numcauses ; s++)
+            printf("    %d x %s\n", causes[s].count, causes[s].cause);
+    }
+
+    printf("total:");
+    for (i=BOT_EXITED ; i<=BOT_TIMEOUT ; i++)
+        printf(" %d %s,", totals[i], outcomes[i]);
+    printf(" %d %s, %.2f us/tick\n", totals[BOT_CRASHED], outcomes[BOT_CRASHED],
+           played ? alltickus / played : 0.0);
+    qsort(allcauses, numallcauses, sizeof(*allcauses), CompareCauses);
+    for (s=0 ; s<numallcauses ; s++)
+        printf("    %d x %s\n", allcauses[s].count, allcauses[s].cause);
+
+    Mem_Free(exitticks);
+}
+
+
+static void PrintMessages (void)
+{
+    mapjob_t *job;
+    int i, j;
+
+    for (i=0, job=jobs ; i<numjobs ; i++, job++)
+    {
+        for (j=0 ; j<job->nummessages ; j++)
+            printf("%s: %s\n", job->file, job->messages[j]);
+        if (job->nummessages < job->numerrors + job->numwarnings)
+            printf("%s: ...and %d more\n", job->file,
+                   job->numerrors + job->numwarnings - job->nummessages);
+    }
+}
+
+
+static void WriteJSONString (FILE *f, const char *s)
+{
+    fputc('"', f);
+    for ( ; *s ; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+
+// {"Spider": 3, ...} for the types with entity flags set or not
+static void WriteJSONCounts (FILE *f, const int counts[NUMTYPES], bool entities)
+{
+    const char *sep;
+    int type;
+
+    fputc('{', f);
+    sep = "";
+    for (type=TYPE_NONE+1 ; type<NUMTYPES ; type++)
+    {
+        if (!counts[type] || !(objdefs[type].flags & OF_ENTITY) != !entities)
+            continue;
+        fputs(sep, f);
+        WriteJSONString(f, objdefs[type].name);
+        fprintf(f, ": %d", counts[type]);
+        sep = ", ";
+    }
+    fputc('}', f);
+}
+
+
+static void WriteJSON (FILE *f)
+{
+    mapjob_t *  job;
+    memstats_t  mem;
+    int         totals[NUMTYPES];
+    int         i, j, type, tag;
+
+    memset(totals, 0, sizeof(totals));
+
+    fprintf(f, "{\n  \"maps\": [");
+    for (i=0, job=jobs ; i<numjobs ; i++, job++)
+    {
+        fprintf(f, "%s\n    {\"file\": ", i ? "," : "");
+        WriteJSONString(f, job->file);
+        fprintf(f, ", \"num\": %d, \"version\": %d, \"bytes\": %zu, \"crc\": \"%08x\", "
+                "\"loaded\": %s, \"errors\": %d, \"warnings\": %d, \"messages\": [",
+                job->num, job->version, job->size, job->crc, job->loaded ? "true" : "false",
+                job->numerrors, job->numwarnings);
+        for (j=0 ; j<job->nummessages ; j++)
+        {
+            if (j)
+                fputs(", ", f);
+            WriteJSONString(f, job->messages[j]);
+        }
+        fprintf(f, "],\n     \"solid\": %.4f, \"entities\": ",
+                (double)job->solid / (MAP_W * MAP_H));
+        WriteJSONCounts(f, job->counts[0], true);
+        fputs(", \"tiles\": ", f);
+        WriteJSONCounts(f, job->counts[0], false);
+        fputs(", \"background\": ", f);
+        WriteJSONCounts(f, job->counts[1], false);
+        fputc('}', f);
+
+        for (type=0 ; type<NUMTYPES ; type++)
+            totals[type] += job->counts[0][type];
+    }
+
+    fprintf(f, "\n  ],\n  \"total\": {\"maps\": %d, \"entities\": ", numjobs);
+    WriteJSONCounts(f, totals, true);
+    fprintf(f, "},\n  \"memory\": {");
+    for (tag=0 ; tag<NUMMEMTAGS ; tag++)
+    {
+        Mem_GetStats(tag, &mem);
+        fprintf(f, "%s\n    \"%s\": {\"live\": %zu, \"peak\": %zu, \"blocks\": %d, \"allocs\": %d}",
+                tag ? "," : "", Mem_TagName(tag), mem.live, mem.peak, mem.blocks, mem.allocs);
+    }
+    fprintf(f, "\n  }\n}\n");
+}
+
+
+static int CountErrors (int *warnings)
+{
+    int i, errors;
+
+    errors = *warnings = 0;
+    for (i=0 ; i<numjobs ; i++) {
+        errors += jobs[i].numerrors;
+        *warnings += jobs[i].numwarnings;
+    }
+    return errors;
+}
+
+
+
+#pragma mark -
+
+static void RunJobs (jobfunc_t func, int numthreads)
+{
+    uint64_t start;
+    double ms;
+    int i, errors, warnings;
+
+    for (i=0 ; i<numthreads ; i++)
+    {
+        scratchmaps[i] = Mem_Alloc(MEM_MAPS, sizeof(map_t));
+        scratchdata[i] = Mem_Alloc(MEM_MAPS, MAPFILE_MAX);
+        if (!scratchmaps[i] || !scratchdata[i])
+            Quit("could not alloc scratch buffers");
+    }
+
+    start = SDL_GetPerformanceCounter();
+    Jobs_Run(func, numjobs, NULL, numthreads);
+    ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    errors = CountErrors(&warnings);
+    fprintf(stderr, "%d maps, %d errors, %d warnings, %.1f ms on %d threads (%.0f maps/s)\n",
+            numjobs, errors, warnings, ms, numthreads, ms > 0 ? numjobs * 1000.0 / ms : 0.0);
+
+    for (i=0 ; i<numthreads ; i++) {
+        Mem_Free(scratchmaps[i]);
+        Mem_Free(scratchdata[i]);
+    }
+}
+
+
+//
+//  RunQuery
+//  Index the maps on this thread, the index isn't shared, and time query
+//
+static void RunQuery (const char *query)
+{
+    static indexmatch_t matches[QUERY_MATCHES];
+    const char *error;
+    uint64_t start, freq;
+    double us, firstus, totalus, maxus;
+    map_t *map;
+    int i, indexed, count;
+
+    scratchmaps[0] = Mem_Alloc(MEM_MAPS, sizeof(map_t));
+    scratchdata[0] = Mem_Alloc(MEM_MAPS, MAPFILE_MAX);
+    if (!scratchmaps[0] || !scratchdata[0])
+        Quit("could not alloc scratch buffers");
+
+    freq = SDL_GetPerformanceFrequency();
+    start = SDL_GetPerformanceCounter();
+    indexed = 0;
+    for (i=0 ; i<numjobs ; i++)
+    {
+        map = LoadJobMap(&jobs[i], 0);
+        if (!map)
+            continue;
+        if (!Index_AddMap(map, jobs[i].crc))
+            Quit("could not index map");
+        indexed++;
+    }
+    fprintf(stderr, "%d maps, %d indexed in %.1f ms\n", numjobs, indexed,
+            (SDL_GetPerformanceCounter() - start) * 1000.0 / freq);
+    Mem_Free(scratchmaps[0]);
+    Mem_Free(scratchdata[0]);
+
+    firstus = totalus = maxus = 0;
+    count = 0;
+    for (i=0 ; i<queryrepeat ; i++)
+    {
+        start = SDL_GetPerformanceCounter();
+        count = Index_Query(query, matches, QUERY_MATCHES, &error);
+        us = (SDL_GetPerformanceCounter() - start) * 1000000.0 / freq;
+        if (count < 0) {
+            fprintf(stderr, "%s\n", error);
+            Quit("bad query");
+        }
+
+        if (!i) {
+            firstus = us;
+            continue;
+        }
+        totalus += us;
+        if (us > maxus)
+            maxus = us;
+    }
+
+    for (i=0 ; i<count ; i++)
+        printf("%d.map: %d\n", matches[i].mapnum, matches[i].count);
+    fprintf(stderr, "\"%s\": %d%s matches, first query %.1f us, then %.1f us mean, "
+            "%.1f us max over %d\n", query, count, count == QUERY_MATCHES ? "+" : "",
+            firstus, queryrepeat > 1 ? totalus / (queryrepeat - 1) : 0.0, maxus,
+            queryrepeat - 1);
+}
+
+
+static void Usage (void)
+{
+    fprintf(stderr,
+            "usage: azki-maptool -check <dir|pack>\n"
+            "       azki-maptool -stats <dir|pack> [-json out.json]\n"
+            "       azki-maptool -convert <dir|pack> <outdir> [-format 1|3]\n"
+            "       azki-maptool -generate <count> <outdir>\n"
+            "       azki-maptool -render <dir|pack> <outdir> [-scale N] [-png store|fast]\n"
+            "       azki-maptool -thumbs <dir|pack> <outdir> [-png store|fast]\n"
+            "       azki-maptool -bot <dir|pack> [-sessions N] [-ticks N] [-seed N]\n"
+            "       azki-maptool -query <dir|pack> <query> [-repeat N]\n"
+            "options: -threads N, -log file\n");
+    Quit("bad arguments");
+}
+
+
+// the argument after parameter check, NULL if none
+static const char *ParameterArg (char *check, int offset)
+{
+    int i;
+
+    i = CheckParameter(check);
+    if (!i || i + offset >= myargc)
+        return NULL;
+    return myargv[i + offset];
+}
+
+
+int main (int argc, char ** argv)
+{
+    const char *    arg;
+    FILE *          json;
+    int             numthreads;
+    int             warnings;
+    int             i, count;
+
+    myargc = argc;
+    myargv = argv;
+
+    Log_Start(ParameterArg("-log", 1));
+    InitMapCodec();
+
+    numthreads = Jobs_DefaultThreads();
+    if ((arg = ParameterArg("-threads", 1)) != NULL)
+        numthreads = clamp(atoi(arg), 1, MAX_JOB_THREADS);
+    if ((arg = ParameterArg("-format", 1)) != NULL)
+        outformat = atoi(arg);
+    if (outformat != 1 && outformat != MAPFILE_VERSION)
+        Usage();
+    if ((arg = ParameterArg("-scale", 1)) != NULL)
+        renderscale = clamp(atoi(arg), 1, 16);
+    if ((arg = ParameterArg("-sessions", 1)) != NULL)
+        botsessions = clamp(atoi(arg), 1, 100000);
+    if ((arg = ParameterArg("-ticks", 1)) != NULL)
+        botticks = atoi(arg);
+    if ((arg = ParameterArg("-seed", 1)) != NULL)
+        botseed = strtoull(arg, NULL, 10);
+    if ((arg = ParameterArg("-repeat", 1)) != NULL)
+        queryrepeat = clamp(atoi(arg), 1, 1000000);
+    if ((arg = ParameterArg("-png", 1)) != NULL)
+    {
+        if (!strcmp(arg, "store"))
+            pngmode = PNG_STORE;
+        else if (!strcmp(arg, "fast"))
+            pngmode = PNG_FAST;
+        else
+            Usage();
+    }
+
+    if ((arg = ParameterArg("-check", 1)) != NULL)
+    {
+        FindMaps(arg);
+        RunJobs(CheckJob, numthreads);
+        PrintMessages();
+    }
+    else if ((arg = ParameterArg("-stats", 1)) != NULL)
+    {
+        FindMaps(arg);
+        RunJobs(CheckJob, numthreads);
+
+        json = stdout;
+        if ((arg = ParameterArg("-json", 1)) != NULL && !(json = fopen(arg, "w")))
+            Quit("could not open JSON file");
+        WriteJSON(json);
+        if (json != stdout)
+            fclose(json);
+    }
+    else if ((arg = ParameterArg("-convert", 1)) != NULL)
+    {
+        if (!(outdir = ParameterArg("-convert", 2)))
+            Usage();
+        MakeOutDir();
+        FindMaps(arg);
+        RunJobs(ConvertJob, numthreads);
+        PrintMessages();
+    }
+    else if ((arg = ParameterArg("-generate", 1)) != NULL)
+    {
+        if (!(outdir = ParameterArg("-generate", 2)))
+            Usage();
+        MakeOutDir();
+        count = atoi(arg);
+        for (i=1 ; i<=count ; i++)
+            NewJob()->num = i;
+        for (i=0 ; i<numjobs ; i++)
+            snprintf(jobs[i].file, sizeof(jobs[i].file), "%s/%d.map", outdir, jobs[i].num);
+        outformat = MAPFILE_VERSION;
+        RunJobs(GenerateJob, numthreads);
+        PrintMessages();
+    }
+    else if ((arg = ParameterArg("-render", 1)) != NULL)
+    {
+        if (!(outdir = ParameterArg("-render", 2)))
+            Usage();
+        MakeOutDir();
+        FindMaps(arg);
+        RunJobs(RenderJob, numthreads);
+        PrintMessages();
+    }
+    else if ((arg = ParameterArg("-thumbs", 1)) != NULL)
+    {
+        if (!(outdir = ParameterArg("-thumbs", 2)))
+            Usage();
+        MakeOutDir();
+        FindMaps(arg);
+        ReadThumbCache();
+        RunJobs(ThumbJob, numthreads);
+        WriteThumbCache();
+        PrintMessages();
+    }
+    else if ((arg = ParameterArg("-bot", 1)) != NULL)
+    {
+        FindMaps(arg);
+        RunBots(numthreads);
+        PrintBots();
+        PrintMessages();
+    }
+    else if ((arg = ParameterArg("-query", 1)) != NULL)
+    {
+        if (!ParameterArg("-query", 2))
+            Usage();
+        FindMaps(arg);
+        RunQuery(ParameterArg("-query", 2));
+        PrintMessages();
+    }
+    else
+    {
+        Usage();
+    }
+
+    Quit(CountErrors(&warnings) ? "errors found" : NULL);
+    return 0;
+}
@@ -0,0 +1,238 @@
+//
+//  mem.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Heap allocations by subsystem. Every block carries a small header with
+//  its size and tag, so frees can be counted against the right tag; live
+//  bytes, peak bytes and allocation counts are kept per tag, under a
+//  spinlock since the writer and job threads allocate too.
+//
+//  With the audit on (-memaudit), a frame between Mem_StartFrame and
+//  Mem_EndFrame that allocates on the thread that started it is logged,
+//  with where its first allocation came from. PlayLoop audits every frame
+//  after its first, which should allocate nothing.
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "mem.h"
+#include "log.h"
+
+// keeps the block after it as aligned as malloc's
+typedef union
+{
+    struct
+    {
+        size_t      size;
+        memtag_t    tag;
+    } info;
+    long double     align;
+} memheader_t;
+
+static const char * tagnames[NUMMEMTAGS] = { "maps", "world", "video", "editor", "misc" };
+
+static memstats_t   stats[NUMMEMTAGS];
+static SDL_SpinLock lock;
+
+static struct
+{
+    bool            on;
+    bool            framing;
+    SDL_threadID    thread;
+    int             frame;
+    int             allocs;
+    size_t          bytes;
+    const char *    file;       // first allocation this frame
+    int             line;
+} audit;
+
+
+
+static void Count (memtag_t tag, size_t size, const char *file, int line)
+{
+    memstats_t *s;
+
+    SDL_AtomicLock(&lock);
+    s = &stats[tag];
+    s->live += size;
+    if (s->live > s->peak)
+        s->peak = s->live;
+    s->blocks++;
+    s->allocs++;
+    SDL_AtomicUnlock(&lock);
+
+    if (audit.framing && SDL_ThreadID() == audit.thread)
+    {
+        if (!audit.allocs++) {
+            audit.file = file;
+            audit.line = line;
+        }
+        audit.bytes += size;
+    }
+}
+
+
+static void Uncount (memtag_t tag, size_t size)
+{
+    SDL_AtomicLock(&lock);
+    stats[tag].live -= size;
+    stats[tag].blocks--;
+    SDL_AtomicUnlock(&lock);
+}
+
+
+void *Mem_AllocAt (memtag_t tag, size_t size, const char *file, int line)
+{
+    memheader_t *h;
+
+    h = malloc(sizeof(*h) + size);
+    if (!h)
+        return NULL;
+
+    h->info.size = size;
+    h->info.tag = tag;
+    Count(tag, size, file, line);
+    return h + 1;
+}
+
+
+void *Mem_CallocAt (memtag_t tag, size_t count, size_t size, const char *file, int line)
+{
+    void *ptr;
+
+    if (size && count > (size_t)-1 / size)
+        return NULL;
+    ptr = Mem_AllocAt(tag, count * size, file, line);
+    if (ptr)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+
+void *Mem_ReallocAt (memtag_t tag, void *ptr, size_t size, const char *file, int line)
+{
+    memheader_t *h, *bigger;
+    size_t old;
+
+    if (!ptr)
+        return Mem_AllocAt(tag, size, file, line);
+
+    h = (memheader_t *)ptr - 1;
+    old = h->info.size;
+    bigger = realloc(h, sizeof(*h) + size);
+    if (!bigger)
+        return NULL;
+
+    Uncount(bigger->info.tag, old);
+    bigger->info.size = size;
+    bigger->info.tag = tag;
+    Count(tag, size, file, line);
+    return bigger + 1;
+}
+
+
+void Mem_Free (void *ptr)
+{
+    memheader_t *h;
+
+    if (!ptr)
+        return;
+
+    h = (memheader_t *)ptr - 1;
+    Uncount(h->info.tag, h->info.size);
+    free(h);
+}
+
+
+
+#pragma mark - Stats
+
+const char *Mem_TagName (memtag_t tag)
+{
+    return tagnames[tag];
+}
+
+
+void Mem_GetStats (memtag_t tag, memstats_t *out)
+{
+    SDL_AtomicLock(&lock);
+    *out = stats[tag];
+    SDL_AtomicUnlock(&lock);
+}
+
+
+//
+//  Mem_GetTotal
+//  All tags together. The peak is the sum of each tag's peak, an upper
+//  bound on the real one.
+//
+void Mem_GetTotal (memstats_t *out)
+{
+    int t;
+
+    memset(out, 0, sizeof(*out));
+    SDL_AtomicLock(&lock);
+    for (t=0 ; t<NUMMEMTAGS ; t++)
+    {
+        out->live += stats[t].live;
+        out->peak += stats[t].peak;
+        out->blocks += stats[t].blocks;
+        out->allocs += stats[t].allocs;
+    }
+    SDL_AtomicUnlock(&lock);
+}
+
+
+void Mem_Report (void)
+{
+    memstats_t s;
+    int t;
+
+    for (t=0 ; t<NUMMEMTAGS ; t++)
+    {
+        Mem_GetStats(t, &s);
+        LogInfo("Mem: %-6s %8zu bytes live in %d blocks, peak %zu, %d allocs",
+                tagnames[t], s.live, s.blocks, s.peak, s.allocs);
+    }
+}
+
+
+
+#pragma mark - Audit
+
+void Mem_SetAudit (bool on)
+{
+    audit.on = on;
+}
+
+
+//
+//  Mem_StartFrame
+//  Start counting this thread's allocations, if auditing
+//
+void Mem_StartFrame (void)
+{
+    if (!audit.on)
+        return;
+
+    audit.framing = true;
+    audit.thread = SDL_ThreadID();
+    audit.allocs = 0;
+    audit.bytes = 0;
+    audit.frame++;
+}
+
+
+void Mem_EndFrame (void)
+{
+    if (!audit.framing)
+        return;
+
+    audit.framing = false;
+    if (audit.allocs)
+        LogWarn("Mem: frame %d made %d allocations, %zu bytes, first at %s:%d",
+                audit.frame, audit.allocs, audit.bytes, audit.file, audit.line);
+}
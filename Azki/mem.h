@@ -0,0 +1,51 @@
+//
+//  mem.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef mem_h
+#define mem_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum
+{
+    MEM_MAPS,       // map files, packs, saves
+    MEM_WORLD,      // snapshots and rewind history
+    MEM_VIDEO,      // images and textures made at startup
+    MEM_EDITOR,     // undo, journal, map index
+    MEM_MISC,
+    NUMMEMTAGS
+} memtag_t;
+
+typedef struct
+{
+    size_t      live;       // bytes
+    size_t      peak;
+    int         blocks;     // live
+    int         allocs;     // ever made
+} memstats_t;
+
+#define Mem_Alloc(tag, size)            Mem_AllocAt(tag, size, __FILE__, __LINE__)
+#define Mem_Calloc(tag, count, size)    Mem_CallocAt(tag, count, size, __FILE__, __LINE__)
+#define Mem_Realloc(tag, ptr, size)     Mem_ReallocAt(tag, ptr, size, __FILE__, __LINE__)
+
+void *  Mem_AllocAt (memtag_t tag, size_t size, const char *file, int line);
+void *  Mem_CallocAt (memtag_t tag, size_t count, size_t size, const char *file, int line);
+void *  Mem_ReallocAt (memtag_t tag, void *ptr, size_t size, const char *file, int line);
+void    Mem_Free (void *ptr);
+
+const char *    Mem_TagName (memtag_t tag);
+void            Mem_GetStats (memtag_t tag, memstats_t *stats);
+void            Mem_GetTotal (memstats_t *stats);
+void            Mem_Report (void);
+
+void    Mem_SetAudit (bool on);
+void    Mem_StartFrame (void);
+void    Mem_EndFrame (void);
+
+#endif /* mem_h */
@@ -12,11 +12,31 @@
 #include "player.h"
 #include "video.h"
 #include "map.h"
+#include "light.h"
 #include "cmdlib.h"
+#include "rng.h"
+#include "azki.h"
+#include "log.h"
+#include "trace.h"
 
 // singly linked list of active (mobile) entities
 obj_t *objlist;
 
+// entity table, objlist is threaded through these slots
+static struct
+{
+    obj_t       entities[MAX_ENTITIES];
+    uint16_t    generation[MAX_ENTITIES];  // kept across levels
+    int         freeslots[MAX_ENTITIES];
+    int         numfree;
+    int         numslots;   // high water mark, reset with the list
+
+    // entities bucketed by type, rebuilt when the list changes
+    obj_t *     typeorder[MAX_ENTITIES];
+    int         typestart[NUMTYPES + 1];
+    bool        typesdirty;
+} table = { .typesdirty = true };
+
 
 const char *ObjName (obj_t *obj)
 {
@@ -71,7 +91,8 @@ bool CanMove (obj_t *obj, tile x, tile y)
     {
         check = objlist;
         do {
-            if ( (check->flags & OF_SOLID) && check->x == x && check->y == y )
+            if ( check->state != objst_remove && (check->flags & OF_SOLID)
+                && check->x == x && check->y == y )
                 return false;
             check = check->next;
         } while (check);
@@ -105,7 +126,8 @@ bool TryMove (obj_t *obj, tile x, tile y)
     {
         check = objlist;
         do {
-            if ( (check->flags & OF_SOLID) && check->x == x && check->y == y )
+            if ( check->state != objst_remove && (check->flags & OF_SOLID)
+                && check->x == x && check->y == y )
             {
                 if (obj->contact)
                     obj->contact(obj, check);
@@ -122,11 +144,29 @@ bool TryMove (obj_t *obj, tile x, tile y)
 }
 
 
+//
+//  ObjRandom
+//  Random number draw for obj this tic. It's a function of the seed, map,
+//  tic, entity and draw only, so it comes out the same whatever order
+//  objects update in. Use a different draw for each number in a tic.
+//  Layer objects (candles) have no serial, their cell stands in for one.
+//
+uint32_t ObjRandom (obj_t *obj, int draw)
+{
+    uint32_t id;
+    
+    id = obj->serial;
+    if (!id)
+        id = 0x80000000 | (obj->y * MAP_W + obj->x + 1); // apart from entities
+    return Rng_Counter(RandomSeed(), draw, id, tics, map.num);
+}
+
+
 bool TryMoveRandom4 (obj_t *obj)
 {
     dir_t dir;
 
-    dir = Random() % 4 + 1; // move spider in a Random direction
+    dir = ObjRandom(obj, 0) % 4 + 1; // move spider in a Random direction
     switch (dir)
     {
         case DIR_EAST:
@@ -206,37 +246,106 @@ void FlashObject (obj_t *obj, int *timer, int color)
 #pragma mark - Object List
 
 
+static handle_t MakeHandle (int slot)
+{
+    if (table.generation[slot] == 0)
+        table.generation[slot] = 1; // 0 is never a valid generation
+    return (handle_t)table.generation[slot] << 16 | slot;
+}
+
+
+//
+// NewGeneration
+// Invalidate all handles to the entity in 'slot'
+//
+static void NewGeneration (int slot)
+{
+    if (++table.generation[slot] == 0)
+        table.generation[slot] = 1;
+}
+
+
 obj_t *
 List_AddObject (obj_t *add)
 {
     obj_t *new;
+    int slot;
+    
+    if (table.numfree)
+        slot = table.freeslots[--table.numfree];
+    else if (table.numslots < MAX_ENTITIES)
+        slot = table.numslots++;
+    else {
+        Quit("List_AddObject: error, entity table full");
+        return NULL; // Quit doesn't return
+    }
     
-    new = malloc(sizeof(obj_t));
-    if (!new)
-        Quit("List_AddObject: error, could not alloc mem");
+    new = &table.entities[slot];
     *new = *add;
     
+    new->id = MakeHandle(slot);
     new->state = objst_active;
     new->next = objlist;
     objlist = new;
+    table.typesdirty = true;
         
     return new;
 }
 
 
+//
+// List_TableState
+// The entity table as one block, for world snapshots
+//
+void *
+List_TableState (size_t *size)
+{
+    *size = sizeof(table);
+    return &table;
+}
+
+
+//
+// List_Resolve
+// Returns the entity for handle, or NULL if it has been removed
+// or changed into something else
+//
+obj_t *
+List_Resolve (handle_t handle)
+{
+    obj_t *obj;
+    int slot;
+    
+    if (handle == NULL_HANDLE)
+        return NULL;
+    
+    slot = handle & 0xFFFF;
+    if (slot >= table.numslots || (handle >> 16) != table.generation[slot])
+        return NULL;
+    
+    obj = &table.entities[slot];
+    if (obj->id != handle || obj->state == objst_remove)
+        return NULL;
+    
+    return obj;
+}
+
+
 //
 // List_RemoveObject
-// Remove object and return the next object in the list
+// Remove object and return the next object in the list.
+// Only called from the remove sweep, mark objects objst_remove instead.
 //
 obj_t *
 List_RemoveObject (obj_t *rem)
 {
     obj_t * prev;
     obj_t * ret;
+    int     slot;
     
     if (!rem)
         Quit("List_RemoveObject: error, tried to remove NULL object!");
-    printf("removed type \"%s\"\n", ObjName(rem));
+    LogDebug("removed type \"%s\"", ObjName(rem));
     
     // the first and only
     if (rem == objlist && !rem->next)
@@ -272,8 +381,15 @@ List_RemoveObject (obj_t *rem)
             ret = rem->next;
         }
     }
-    free(rem);
-    rem = NULL;
+    
+    // free the slot
+    slot = (int)(rem - table.entities);
+    NewGeneration(slot);
+    rem->id = NULL_HANDLE;
+    rem->state = objst_remove;
+    table.freeslots[table.numfree++] = slot;
+    table.typesdirty = true;
+    
     return ret;
 }
 
@@ -283,7 +399,6 @@ void
 List_RemoveAll (void)
 {
     obj_t * obj;
-    obj_t * temp;
     int i;
     
     if (!objlist)
@@ -292,13 +407,105 @@ List_RemoveAll (void)
     i = 0;
     obj = objlist;
     while (obj) {
-        temp = obj;
+        NewGeneration((int)(obj - table.entities));
+        obj->id = NULL_HANDLE;
         obj = obj->next;
-        free(temp);
         i++;
     };
     objlist = NULL;
-    printf("List_RemoveAll: removed %i objects\n", i);
+    
+    // the table is empty, start handing out slots from the bottom again
+    table.numslots = 0;
+    table.numfree = 0;
+    table.typesdirty = true;
+    LogDebug("List_RemoveAll: removed %i objects", i);
+}
+
+
+//
+// SortByType
+// Stable counting sort of the list into per-type buckets: the objects
+// of type t are order[start[t]] to order[start[t+1]-1], in list order.
+// Returns the number of objects sorted.
+//
+static int SortByType (obj_t **order, int *start)
+{
+    int     pos[NUMTYPES];
+    obj_t * obj;
+    int     t;
+    
+    memset(pos, 0, sizeof(pos));
+    for (obj=objlist ; obj ; obj=obj->next)
+    {
+        if (obj->state != objst_remove)
+            pos[obj->type]++;
+    }
+    
+    start[0] = 0;
+    for (t=0 ; t<NUMTYPES ; t++)
+    {
+        start[t + 1] = start[t] + pos[t];
+        pos[t] = start[t];
+    }
+    
+    for (obj=objlist ; obj ; obj=obj->next)
+    {
+        if (obj->state != objst_remove)
+            order[pos[obj->type]++] = obj;
+    }
+    
+    return start[NUMTYPES];
+}
+
+
+//
+// List_ObjectsOfType
+// Returns all objects of type and sets count. Valid until the list
+// changes; may include objects that were marked for removal since.
+//
+obj_t **
+List_ObjectsOfType (objtype_t type, int *count)
+{
+    if (table.typesdirty)
+    {
+        SortByType(table.typeorder, table.typestart);
+        table.typesdirty = false;
+    }
+    
+    *count = table.typestart[type + 1] - table.typestart[type];
+    return &table.typeorder[table.typestart[type]];
+}
+
+
+//
+// List_UpdateObjects
+// Call every object's update, batched by type so all spiders update,
+// then all ogres, etc. Within a type, list order is kept.
+//
+void List_UpdateObjects (void)
+{
+    static obj_t *  order[MAX_ENTITIES];
+    static int      start[NUMTYPES + 1];
+    obj_t *         obj;
+    int             t, i;
+    
+    // sort into a private order, updates may spawn or change objects
+    SortByType(order, start);
+    
+    for (t=0 ; t<NUMTYPES ; t++)
+    {
+        if (!objdefs[t].update || start[t] == start[t + 1])
+            continue;
+        
+        TraceBegin(objdefs[t].name);
+        for (i=start[t] ; i<start[t + 1] ; i++)
+        {
+            obj = order[i];
+            if (obj->update)
+                obj->update(obj);
+        }
+        TraceEnd(objdefs[t].name);
+    }
 }
 
 
@@ -332,9 +539,14 @@ void List_DrawObjects (void)
     obj = objlist;
     do {
         if (obj->type != TYPE_NONE && obj->type != TYPE_PLAYER)
+        {
+            if (darkmap)
+                SetLightLevel(lightmap[obj->y][obj->x]);
             DrawGlyph(&obj->glyph, draw_x(obj->x), draw_y(obj->y), PITCHBLACK);
+        }
         obj = obj->next;
     } while (obj);
+    SetLightLevel(LIGHT_FULL);
 }
 
 
@@ -409,16 +621,36 @@ obj_t NewObjectFromDef (objtype_t type, tile x, tile y)
 }
 
 
+//
+//  ChangeObject
+//  Turn obj into a new object of type. Entities keep their table slot,
+//  but handles to what it was no longer resolve.
+//
 void ChangeObject (obj_t *obj, objtype_t type, int state)
 {
     obj_t *next;
+    uint32_t serial;
+    int slot;
+    
+    LogDebug("changing obj of type %s to type %s...", ObjName(obj), objdefs[type].name);
     
-    printf("changing obj of type %s to type %s...\n", ObjName(obj), objdefs[type].name);
+    slot = -1;
+    if (obj->id != NULL_HANDLE)
+        slot = (int)(obj - table.entities);
     
     next = obj->next; // save it because NewObject resets it
+    serial = obj->serial;
     *obj = NewObjectFromDef(type, obj->x, obj->y);
     obj->next = next;
+    obj->serial = serial;
     obj->state = state;
+    
+    if (slot != -1)
+    {
+        NewGeneration(slot);
+        obj->id = MakeHandle(slot);
+        table.typesdirty = true;
+    }
 }
 
 
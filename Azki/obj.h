@@ -89,8 +89,17 @@ typedef enum
     OF_BREAKABLE    = 0x0040,
     // inflicts damage on player
     OF_DAMAGING     = 0x0080,
+    // solid, but doesn't cast shadows
+    OF_TRANSLUCENT  = 0x0100,
 } objflags_t;
 
+// entity handle: entity table slot in the low 16 bits, the slot's
+// generation in the high 16. Resolves to NULL once the entity is gone.
+typedef uint32_t handle_t;
+
+#define NULL_HANDLE     0
+#define MAX_ENTITIES    1024
+
 struct objdef_s;
 struct obj_s;
 
@@ -132,12 +141,19 @@ typedef struct obj_s
     action1_t   update;
     action2_t   contact;
     
+    // this entity's handle, NULL_HANDLE for layer objects
+    handle_t    id;
+    
+    // where the entity started, y * MAP_W + x + 1, so its random
+    // numbers don't depend on where it's stored; 0 for layer objects
+    // and spawns, which ObjRandom tells apart by their cell
+    uint32_t    serial;
+    
     // who created this object, e.g. projectiles
-    // player: the thing that killed the player
-    struct obj_s *src;
+    handle_t    src;
     
     // object's target, e.g. projectiles
-    struct obj_s *dst;
+    handle_t    dst;
     
     // linked list
     struct obj_s *next;
@@ -165,6 +181,7 @@ const char *    ObjectNameAtXY (tile x, tile y);
 
 bool        TryMove (obj_t *obj, tile x, tile y);
 bool        TryMoveRandom4 (obj_t *obj);
+uint32_t    ObjRandom (obj_t *obj, int draw);
 objtype_t   ObjectTypeAtXY (tile x, tile y);
 glyph_t *   ObjectGlyphAtXY (tile x, tile y);
 bool        ObjectsOverlap (obj_t *obj1, obj_t *obj2);
@@ -178,9 +195,13 @@ void ChangeObject (obj_t *obj, objtype_t type, int state);
 void DrawObject (obj_t *obj);
 
 obj_t *     List_AddObject (obj_t *add);
+obj_t *     List_Resolve (handle_t handle);
+void *      List_TableState (size_t *size);
 obj_t *     List_RemoveObject (obj_t *rem);
 void        List_RemoveAll (void);
 int         List_Count (void);
+obj_t **    List_ObjectsOfType (objtype_t type, int *count);
+void        List_UpdateObjects (void);
 void        List_DrawObjects (void);
 objtype_t   List_ObjectAtXY (tile x, tile y);
 
@@ -0,0 +1,325 @@
+//
+//  pack.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  All levels in one file:
+//
+//  [packheader_t][level payload][level payload]...[packentry_t dir]
+//
+//  The pack is opened once and mapped read-only, so a level's tile data
+//  is used in place instead of being read. Payloads are aligned to
+//  PACK_ALIGN. Without mmap (Windows) the whole file is read into memory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "pack.h"
+#include "azki.h"
+#include "levels.h"
+#include "mapcodec.h"
+#include "cmdlib.h"
+#include "mem.h"
+#include "log.h"
+
+static const byte *         packdata;
+static size_t               packsize;
+static const packentry_t *  directory;
+static int                  numentries;
+static char                 packpath[256];
+
+
+
+#pragma mark - Mapping
+
+#ifndef _WIN32
+
+static const byte *MapFile (const char *path, size_t *size)
+{
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *size = st.st_size;
+    return data;
+}
+
+
+static void UnmapFile (const byte *data, size_t size)
+{
+    munmap((void *)data, size);
+}
+
+#else
+
+static const byte *MapFile (const char *path, size_t *size)
+{
+    FILE *file;
+    byte *data;
+    long length;
+
+    file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = length > 0 ? Mem_Alloc(MEM_MAPS, length) : NULL;
+    if (data && fread(data, length, 1, file) != 1) {
+        Mem_Free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    *size = length;
+    return data;
+}
+
+
+static void UnmapFile (const byte *data, size_t size)
+{
+    Mem_Free((void *)data);
+}
+
+#endif
+
+
+
+#pragma mark -
+
+//
+//  Pack_Open
+//  Map a pack file and check its directory. Returns false (with no
+//  pack open) if it isn't there or isn't valid.
+//
+bool Pack_Open (const char *path)
+{
+    const packheader_t *header;
+    const packentry_t *entry;
+    size_t size;
+    int i;
+
+    Pack_Close();
+
+    packdata = MapFile(path, &packsize);
+    if (!packdata)
+        return false;
+
+    header = (const packheader_t *)packdata;
+    size = packsize;
+    if (size < sizeof(*header)
+        || memcmp(header->magic, PACK_MAGIC, 4)
+        || header->version != PACK_VERSION
+        || header->diroffset > size
+        || header->numlevels > (size - header->diroffset) / sizeof(packentry_t))
+    {
+        LogError("Pack_Open: %s is not a version %d pack", path, PACK_VERSION);
+        Pack_Close();
+        return false;
+    }
+
+    directory = (const packentry_t *)(packdata + header->diroffset);
+    numentries = header->numlevels;
+
+    for (i=0, entry=directory ; i<numentries ; i++, entry++)
+    {
+        if (entry->offset > size || entry->size > size - entry->offset) {
+            LogError("Pack_Open: %s level %d is out of bounds", path, entry->num);
+            Pack_Close();
+            return false;
+        }
+    }
+
+    snprintf(packpath, sizeof(packpath), "%s", path);
+    LogInfo("Pack_Open: %s, %d levels, %zu bytes", path, numentries, packsize);
+    return true;
+}
+
+
+void Pack_Close (void)
+{
+    if (packdata)
+        UnmapFile(packdata, packsize);
+
+    packdata = NULL;
+    packsize = 0;
+    directory = NULL;
+    numentries = 0;
+    packpath[0] = '\0';
+}
+
+
+//
+//  Pack_Path
+//  The open pack's file, which -pack may have changed from PACK_FILE
+//
+const char * Pack_Path (void)
+{
+    return packpath;
+}
+
+
+int Pack_NumLevels (void)
+{
+    return numentries;
+}
+
+
+const packentry_t * Pack_Entry (int index)
+{
+    if (index < 0 || index >= numentries)
+        return NULL;
+    return &directory[index];
+}
+
+
+const packentry_t * Pack_FindLevel (int num)
+{
+    int i;
+
+    for (i=0 ; i<numentries ; i++)
+    {
+        if (directory[i].num == num)
+            return &directory[i];
+    }
+
+    return NULL;
+}
+
+
+//
+//  Pack_LevelData
+//  Pointer to a level's payload in the mapping, valid until Pack_Close
+//
+const void * Pack_LevelData (const packentry_t *entry)
+{
+    return packdata + entry->offset;
+}
+
+
+
+#pragma mark - Building
+
+static bool WritePadding (FILE *file)
+{
+    static const byte zeros[PACK_ALIGN];
+    long pos;
+
+    pos = ftell(file);
+    if (pos % PACK_ALIGN == 0)
+        return true;
+    return fwrite(zeros, PACK_ALIGN - pos % PACK_ALIGN, 1, file) == 1;
+}
+
+
+//
+//  Pack_Write
+//  Build a pack of every level in the manifest
+//
+bool Pack_Write (const char *path)
+{
+    packheader_t        header;
+    packentry_t *       dir;
+    packentry_t *       entry;
+    levelinfo_t *       info;
+    byte                buffer[MAPFILE_MAX];
+    const byte *        data;
+    size_t              size;
+    FILE *              file;
+    char                temp[256];
+    int                 i, count;
+    bool                ok;
+
+    info = LevelList(&count);
+    dir = Mem_Calloc(MEM_MAPS, count ? count : 1, sizeof(*dir));
+    if (!dir)
+        Quit("Pack_Write: could not alloc directory");
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.numlevels = count;
+
+    // written beside and renamed over, packed levels may be coming
+    // from the current mapping of path
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    file = fopen(temp, "wb");
+    if (!file) {
+        LogError("Pack_Write: couldn't open %s!", temp);
+        Mem_Free(dir);
+        return false;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (i=0, entry=dir ; ok && i<count ; i++, entry++, info++)
+    {
+        data = ReadMapFile(info->num, buffer, &size);
+        if (!data) {
+            LogError("Pack_Write: couldn't read level %d", info->num);
+            ok = false;
+            break;
+        }
+
+        ok = WritePadding(file);
+        entry->num = info->num;
+        entry->offset = (uint32_t)ftell(file);
+        entry->size = (uint32_t)size;
+        entry->crc = CRC32(data, size);
+        entry->flags = info->flags & ~LF_PACKED;
+        snprintf(entry->name, sizeof(entry->name), "%s", info->name);
+        ok = ok && fwrite(data, size, 1, file) == 1;
+    }
+
+    if (ok)
+    {
+        ok = WritePadding(file);
+        header.diroffset = (uint32_t)ftell(file);
+        ok = ok && fwrite(dir, sizeof(*dir), count, file) == count;
+        fseek(file, 0, SEEK_SET);
+        ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+    Mem_Free(dir);
+    
+#ifdef _WIN32
+    if (ok)
+        remove(path);
+#endif
+    if (ok && rename(temp, path) != 0)
+        ok = false;
+    if (!ok)
+        remove(temp);
+
+    if (ok)
+        LogInfo("Pack_Write: wrote %d levels to %s", count, path);
+    else
+        LogError("Pack_Write: failed writing %s", path);
+    return ok;
+}
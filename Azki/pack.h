@@ -0,0 +1,49 @@
+//
+//  pack.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef pack_h
+#define pack_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "map.h"
+
+#define PACK_FILE       "maps/azki.pak"
+#define PACK_MAGIC      "AZPK"
+#define PACK_VERSION    2       // 2: names sized to MAP_NAME_LEN
+#define PACK_NAME_LEN   (MAP_NAME_LEN + 1)  // as levelinfo_t's
+#define PACK_ALIGN      16      // payload alignment in the file
+
+typedef struct
+{
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    numlevels;
+    uint32_t    diroffset;
+} packheader_t;
+
+typedef struct
+{
+    int32_t     num;
+    uint32_t    offset;
+    uint32_t    size;
+    uint32_t    crc;
+    uint32_t    flags;      // LF_ flags
+    char        name[PACK_NAME_LEN];
+} packentry_t;
+
+bool Pack_Open (const char *path);
+void Pack_Close (void);
+const char * Pack_Path (void);
+int  Pack_NumLevels (void);
+const packentry_t * Pack_Entry (int index);
+const packentry_t * Pack_FindLevel (int num);
+const void * Pack_LevelData (const packentry_t *entry);
+bool Pack_Write (const char *path);
+
+#endif /* pack_h */
@@ -12,6 +12,8 @@
 #include "glyph.h"
 #include "map.h"
 #include "cmdlib.h"
+#include "input.h"
+#include "log.h"
 
 typedef struct
 {
@@ -100,7 +102,7 @@ void P_SwingSword (dir_t dir)
     }
     
     if (fg_hit) {
-        printf("hit type: %s\n",ObjName(fg_hit));
+        LogDebug("hit type: %s", ObjName(fg_hit));
         fg_hit->hp--;
         if ((fg_hit->flags & OF_BREAKABLE) && fg_hit->hp <= 0)
             RemoveObj(fg_hit);
@@ -174,42 +176,48 @@ void P_Attack (dir_t dir)
 void P_PlayerInput (void)
 {
     // movement
-    if (keys[SDL_SCANCODE_W])
+    if (Input_Button(BT_NORTH))
         player.obj->dy = -1;
-    if (keys[SDL_SCANCODE_S] || keys[SDL_SCANCODE_X])
+    if (Input_Button(BT_SOUTH))
         player.obj->dy = 1;
-    if (keys[SDL_SCANCODE_A])
+    if (Input_Button(BT_WEST))
         player.obj->dx = -1;
-    if (keys[SDL_SCANCODE_D])
+    if (Input_Button(BT_EAST))
         player.obj->dx = 1;
     
     // diagonals
-    if (keys[SDL_SCANCODE_Q]) {
+    if (Input_Button(BT_NORTHWEST)) {
         player.obj->dx = -1;
         player.obj->dy = -1;
     }
-    if (keys[SDL_SCANCODE_E]) {
+    if (Input_Button(BT_NORTHEAST)) {
         player.obj->dx = 1;
         player.obj->dy = -1;
     }
-    if (keys[SDL_SCANCODE_Z]) {
+    if (Input_Button(BT_SOUTHWEST)) {
         player.obj->dx = -1;
         player.obj->dy = 1;
     }
-    if (keys[SDL_SCANCODE_C]) {
+    if (Input_Button(BT_SOUTHEAST)) {
         player.obj->dx = 1;
         player.obj->dy = 1;
     }
         
     // shoot
-    if (keys[SDL_SCANCODE_UP])
+    if (Input_Button(BT_ATTACKNORTH))
         P_Attack(DIR_NORTH);
-    if (keys[SDL_SCANCODE_DOWN])
+    if (Input_Button(BT_ATTACKSOUTH))
         P_Attack(DIR_SOUTH);
-    if (keys[SDL_SCANCODE_LEFT])
+    if (Input_Button(BT_ATTACKWEST))
         P_Attack(DIR_WEST);
-    if (keys[SDL_SCANCODE_RIGHT])
+    if (Input_Button(BT_ATTACKEAST))
         P_Attack(DIR_EAST);
+    
+    // put the sword away once no attack is held, even after a tap that
+    // came and went within a frame
+    if (!Input_Button(BT_ATTACKNORTH) && !Input_Button(BT_ATTACKSOUTH)
+        && !Input_Button(BT_ATTACKWEST) && !Input_Button(BT_ATTACKEAST))
+        sword_dir = DIR_NONE;
 }
 
 
@@ -231,7 +239,7 @@ bool P_HasKey (obj_t *door)
                 return true;
             break;
         default:
-            printf("Weird door type!?");
+            LogWarn("Weird door type!?");
             break;
     }
     return false;
@@ -299,7 +307,8 @@ void P_TryPushObject(obj_t *obj, int dx, int dy)
 void P_UpdatePlayer (obj_t * pl)
 {
     int newx, newy;
-    obj_t *contact, *check;
+    obj_t *contact, **blocks;
+    int i, numblocks;
     const int movedelay = 10;
 
     FlashObject(pl, &player.cooldown, RED);
@@ -343,16 +352,15 @@ void P_UpdatePlayer (obj_t * pl)
                 break;
         }
         
-        check = objlist;
-        do
+        blocks = List_ObjectsOfType(TYPE_BLOCK, &numblocks);
+        for (i=0 ; i<numblocks ; i++)
         {
-            if ((check->flags & OF_PUSHABLE)
-                && check->x == newx && check->y == newy)
+            if ((blocks[i]->flags & OF_PUSHABLE)
+                && blocks[i]->x == newx && blocks[i]->y == newy)
             {
-                TryMove(check, check->x + pl->dx, check->y + pl->dy);
+                TryMove(blocks[i], blocks[i]->x + pl->dx, blocks[i]->y + pl->dy);
             }
-            check = check->next;
-        } while(check);
+        }
         
         if ( !TryMove(pl, newx, newy) ) {
             if (contact->type == TYPE_WATER && player.items.boat) {
@@ -0,0 +1,395 @@
+//
+//  png.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  A small PNG writer for 8-bit RGB images, with its own zlib stream:
+//  either stored blocks or a single fixed-Huffman deflate block from a
+//  greedy LZ77 pass (one hash probe per byte). Map renders are mostly
+//  repeated tiles, so that gets most of what full deflate would.
+//
+//  Everything is local to the call, so images can be encoded on any
+//  number of threads at once.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "png.h"
+#include "mem.h"
+
+#define WINDOW_SIZE     32768
+#define HASH_BITS       15
+#define MIN_MATCH       3
+#define MAX_MATCH       258
+#define MAX_STORED      65535
+#define MAX_INSERT      16      // longer matches don't hash what they cover
+
+typedef struct
+{
+    byte *      out;
+    size_t      len;
+    uint32_t    bits;
+    int         numbits;
+
+    // the fixed literal/length code, bit reversed
+    uint16_t    codes[288];
+    byte        lengths[288];
+} bitwriter_t;
+
+static const uint16_t lengthbase[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const byte lengthextra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distbase[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+    12289, 16385, 24577
+};
+
+static const byte distextra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+
+
+#pragma mark - Deflate
+
+static void PutBits (bitwriter_t *bw, uint32_t value, int count)
+{
+    bw->bits |= value << bw->numbits;
+    bw->numbits += count;
+    while (bw->numbits >= 8)
+    {
+        bw->out[bw->len++] = bw->bits;
+        bw->bits >>= 8;
+        bw->numbits -= 8;
+    }
+}
+
+
+// Huffman codes go most significant bit first
+static uint32_t Reverse (uint32_t code, int count)
+{
+    uint32_t reversed;
+    int i;
+
+    reversed = 0;
+    for (i=0 ; i<count ; i++, code>>=1)
+        reversed = (reversed << 1) | (code & 1);
+    return reversed;
+}
+
+
+static void InitFixedCodes (bitwriter_t *bw)
+{
+    int sym;
+
+    for (sym=0 ; sym<288 ; sym++)
+    {
+        if (sym < 144) {
+            bw->codes[sym] = Reverse(0x30 + sym, 8);
+            bw->lengths[sym] = 8;
+        } else if (sym < 256) {
+            bw->codes[sym] = Reverse(0x190 + sym - 144, 9);
+            bw->lengths[sym] = 9;
+        } else if (sym < 280) {
+            bw->codes[sym] = Reverse(sym - 256, 7);
+            bw->lengths[sym] = 7;
+        } else {
+            bw->codes[sym] = Reverse(0xC0 + sym - 280, 8);
+            bw->lengths[sym] = 8;
+        }
+    }
+}
+
+
+// a literal/length symbol from the fixed code
+static void PutSymbol (bitwriter_t *bw, int sym)
+{
+    PutBits(bw, bw->codes[sym], bw->lengths[sym]);
+}
+
+
+static void PutMatch (bitwriter_t *bw, int length, int distance)
+{
+    int i;
+
+    for (i=28 ; lengthbase[i] > length ; i--)
+        ;
+    PutSymbol(bw, 257 + i);
+    PutBits(bw, length - lengthbase[i], lengthextra[i]);
+
+    for (i=29 ; distbase[i] > distance ; i--)
+        ;
+    PutBits(bw, Reverse(i, 5), 5);
+    PutBits(bw, distance - distbase[i], distextra[i]);
+}
+
+
+static unsigned Hash3 (const byte *p)
+{
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+//
+//  DeflateFast
+//  One fixed-Huffman block, out must hold size * 9 / 8 + 16 bytes
+//
+static size_t DeflateFast (const byte *in, size_t size, byte *out)
+{
+    bitwriter_t bw;
+    int32_t *   head;
+    size_t      pos, limit, candidate;
+    int         length;
+
+    head = Mem_Alloc(MEM_VIDEO, sizeof(*head) << HASH_BITS);
+    if (!head)
+        return 0;
+    memset(head, 0xFF, sizeof(*head) << HASH_BITS);
+
+    bw.out = out;
+    bw.len = 0;
+    bw.bits = 0;
+    bw.numbits = 0;
+    InitFixedCodes(&bw);
+    PutBits(&bw, 1, 1); // final block
+    PutBits(&bw, 1, 2); // fixed Huffman
+
+    pos = 0;
+    while (pos < size)
+    {
+        length = 0;
+        if (pos + MIN_MATCH <= size)
+        {
+            unsigned h = Hash3(in + pos);
+
+            candidate = head[h];
+            head[h] = (int32_t)pos;
+            if (candidate != (size_t)-1 && pos - candidate <= WINDOW_SIZE)
+            {
+                limit = size - pos < MAX_MATCH ? size - pos : MAX_MATCH;
+                while (length < limit && in[candidate + length] == in[pos + length])
+                    length++;
+            }
+        }
+
+        if (length < MIN_MATCH)
+        {
+            PutSymbol(&bw, in[pos++]);
+            continue;
+        }
+
+        PutMatch(&bw, length, (int)(pos - candidate));
+        if (length > MAX_INSERT) {
+            pos += length;
+            continue;
+        }
+        for (pos++, length-- ; length > 0 ; pos++, length--)
+            if (pos + MIN_MATCH <= size)
+                head[Hash3(in + pos)] = (int32_t)pos;
+    }
+
+    PutSymbol(&bw, 256); // end of block
+    PutBits(&bw, 0, 7); // flush
+    Mem_Free(head);
+
+    return bw.len;
+}
+
+
+//
+//  DeflateStored
+//  out must hold size + 5 bytes per MAX_STORED + 5
+//
+static size_t DeflateStored (const byte *in, size_t size, byte *out)
+{
+    byte *  p;
+    size_t  chunk;
+
+    p = out;
+    do {
+        chunk = size < MAX_STORED ? size : MAX_STORED;
+        *p++ = chunk == size; // final block flag, type 0
+        *p++ = chunk;
+        *p++ = chunk >> 8;
+        *p++ = ~chunk;
+        *p++ = ~chunk >> 8;
+        memcpy(p, in, chunk);
+        p += chunk;
+        in += chunk;
+        size -= chunk;
+    } while (size);
+
+    return p - out;
+}
+
+
+static uint32_t Adler32 (const byte *data, size_t size)
+{
+    uint32_t a, b;
+    size_t n;
+
+    a = 1;
+    b = 0;
+    while (size)
+    {
+        n = size < 5552 ? size : 5552; // most before the sums can overflow
+        size -= n;
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+
+
+#pragma mark - PNG
+
+static void PutBE32 (byte *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+
+// chunk data must already be at p + 8
+static byte *FinishChunk (byte *p, const char *type, size_t length)
+{
+    PutBE32(p, (uint32_t)length);
+    memcpy(p + 4, type, 4);
+    PutBE32(p + 8 + length, CRC32(p + 4, length + 4));
+    return p + 12 + length;
+}
+
+
+//
+//  FilterRow
+//  Write a scanline with the Sub filter. Tiles are runs of a few colors
+//  across a row, which Sub turns into runs of zeros; choosing a filter
+//  per row by the usual sum heuristic came out slower and bigger.
+//
+static void FilterRow (const byte *row, int rowbytes, byte *out)
+{
+    int i;
+
+    *out++ = 1;
+    for (i=0 ; i<IMAGE_BPP ; i++)
+        *out++ = row[i];
+    for ( ; i<rowbytes ; i++)
+        *out++ = row[i] - row[i - IMAGE_BPP];
+}
+
+
+//
+//  PNG_Encode
+//  Returns a malloc'd PNG file, NULL if out of memory
+//
+byte * PNG_Encode (const image_t *img, pngmode_t mode, size_t *size)
+{
+    static const byte signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    byte *      raw;
+    byte *      png;
+    byte *      p;
+    byte *      idat;
+    size_t      rawsize, maxsize, zsize;
+    int         rowbytes, y;
+
+    rowbytes = img->w * IMAGE_BPP;
+    rawsize = (size_t)(rowbytes + 1) * img->h;
+    raw = Mem_Alloc(MEM_VIDEO, rawsize);
+    maxsize = 8 + 25 + 12 + 6 + rawsize + rawsize / 8 + 5 * (rawsize / MAX_STORED + 1) + 32 + 12;
+    png = Mem_Alloc(MEM_VIDEO, maxsize);
+    if (!raw || !png) {
+        Mem_Free(raw);
+        Mem_Free(png);
+        return NULL;
+    }
+
+    // scanlines: stored as is, filtered for deflate
+    for (y=0 ; y<img->h ; y++)
+    {
+        const byte *row = img->pixels + (size_t)y * rowbytes;
+        byte *out = raw + (size_t)y * (rowbytes + 1);
+
+        if (mode == PNG_STORE) {
+            out[0] = 0;
+            memcpy(out + 1, row, rowbytes);
+        } else {
+            FilterRow(row, rowbytes, out);
+        }
+    }
+
+    memcpy(png, signature, 8);
+    p = png + 8;
+
+    PutBE32(p + 8, img->w);
+    PutBE32(p + 12, img->h);
+    p[16] = 8;  // bit depth
+    p[17] = 2;  // RGB
+    p[18] = 0;  // deflate
+    p[19] = 0;  // adaptive filtering
+    p[20] = 0;  // no interlace
+    p = FinishChunk(p, "IHDR", 13);
+
+    idat = p + 8;
+    idat[0] = 0x78; // deflate, 32K window
+    idat[1] = 0x01;
+    if (mode == PNG_STORE)
+        zsize = DeflateStored(raw, rawsize, idat + 2);
+    else
+        zsize = DeflateFast(raw, rawsize, idat + 2);
+    if (!zsize) {
+        Mem_Free(raw);
+        Mem_Free(png);
+        return NULL;
+    }
+    PutBE32(idat + 2 + zsize, Adler32(raw, rawsize));
+    p = FinishChunk(p, "IDAT", zsize + 6);
+
+    p = FinishChunk(p, "IEND", 0);
+
+    Mem_Free(raw);
+    *size = p - png;
+    return png;
+}
+
+
+bool PNG_Write (const char *path, const image_t *img, pngmode_t mode)
+{
+    FILE *  file;
+    byte *  png;
+    size_t  size;
+    bool    ok;
+
+    png = PNG_Encode(img, mode, &size);
+    if (!png)
+        return false;
+
+    file = fopen(path, "wb");
+    ok = file && fwrite(png, size, 1, file) == 1;
+    if (file && fclose(file) != 0)
+        ok = false;
+
+    Mem_Free(png);
+    return ok;
+}
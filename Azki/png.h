@@ -0,0 +1,25 @@
+//
+//  png.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef png_h
+#define png_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "image.h"
+
+typedef enum
+{
+    PNG_STORE,      // no compression, fastest to write
+    PNG_FAST        // one-pass LZ77 with fixed Huffman codes
+} pngmode_t;
+
+byte * PNG_Encode (const image_t *img, pngmode_t mode, size_t *size);
+bool   PNG_Write (const char *path, const image_t *img, pngmode_t mode);
+
+#endif /* png_h */
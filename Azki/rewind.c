@@ -0,0 +1,492 @@
+//
+//  rewind.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Rewind history is a ring of frames, newest at the head. Each tick
+//  the world regions are compared word by word against a shadow copy
+//  of the previous tick, and the runs of words that changed are stored
+//  with their old values, so a frame costs only what actually changed.
+//  Stepping back pops the newest frame and writes the old values back.
+//
+//  Frame types:
+//  FRAME_DELTA     runs of (word offset, word count, old words)
+//  FRAME_UNDO      the whole previous state, when a delta would be bigger
+//  FRAME_KEY       the whole state at that tick, lets R_JumpBack skip
+//                  straight to it instead of undoing each delta
+//
+//  Each frame is [header][payload][size] so the ring can be walked from
+//  either end: oldest frames are evicted from the tail to stay in budget.
+
+#include <SDL2/SDL.h>
+#include <string.h>
+#include "rewind.h"
+#include "world.h"
+#include "azki.h"
+#include "cmdlib.h"
+#include "mem.h"
+#include "log.h"
+
+enum
+{
+    FRAME_DELTA,
+    FRAME_UNDO,
+    FRAME_KEY
+};
+
+#define FRAME_TYPE(h)   ((h) >> 28)
+#define FRAME_SIZE(h)   ((h) & 0x0FFFFFFF)
+
+static byte *       ring;
+static size_t       ringsize;
+static uint64_t     head;       // byte counters, position is % ringsize
+static uint64_t     tail;
+static int          numframes;
+static int          numkeys;
+static int          maxframes;  // ticks of history (+ keyframes)
+
+static byte *       prev;       // world state as of the last recorded tick
+static byte *       scratch;    // frame being built or popped
+static size_t       statesize;
+
+static int          keyinterval;
+static int          sincekey;
+
+
+
+#pragma mark - Ring
+
+static void RingWrite (const void *src, size_t len)
+{
+    size_t pos, first;
+    
+    pos = head % ringsize;
+    first = len < ringsize - pos ? len : ringsize - pos;
+    memcpy(ring + pos, src, first);
+    memcpy(ring, (const byte *)src + first, len - first);
+    head += len;
+}
+
+
+static void RingRead (uint64_t at, void *dst, size_t len)
+{
+    size_t pos, first;
+    
+    pos = at % ringsize;
+    first = len < ringsize - pos ? len : ringsize - pos;
+    memcpy(dst, ring + pos, first);
+    memcpy((byte *)dst + first, ring, len - first);
+}
+
+
+static void DropOldest (void)
+{
+    uint32_t header;
+    
+    RingRead(tail, &header, sizeof(header));
+    tail += FRAME_SIZE(header) + sizeof(uint32_t) * 2;
+    if (FRAME_TYPE(header) == FRAME_KEY)
+        numkeys--;
+    numframes--;
+}
+
+
+static void PushFrame (int type, const void *payload, size_t size)
+{
+    uint32_t header;
+    uint32_t footer;
+    size_t total;
+    
+    total = size + sizeof(uint32_t) * 2;
+    if (total > ringsize)
+    {
+        // can't keep any history past this
+        head = tail = 0;
+        numframes = numkeys = 0;
+        return;
+    }
+    
+    while (numframes && (head - tail + total > ringsize || numframes >= maxframes))
+        DropOldest();
+    
+    header = (uint32_t)type << 28 | (uint32_t)size;
+    footer = (uint32_t)size;
+    RingWrite(&header, sizeof(header));
+    RingWrite(payload, size);
+    RingWrite(&footer, sizeof(footer));
+    
+    numframes++;
+    if (type == FRAME_KEY)
+        numkeys++;
+}
+
+
+//
+//  PopFrame
+//  Take the newest frame off the ring into scratch, returns its type
+//  or -1 if there's no history left
+//
+static int PopFrame (size_t *size)
+{
+    uint32_t header;
+    uint32_t footer;
+    uint64_t start;
+    
+    if (!numframes)
+        return -1;
+    
+    RingRead(head - sizeof(footer), &footer, sizeof(footer));
+    start = head - sizeof(footer) - footer - sizeof(header);
+    RingRead(start, &header, sizeof(header));
+    RingRead(start + sizeof(header), scratch, footer);
+    head = start;
+    
+    numframes--;
+    if (FRAME_TYPE(header) == FRAME_KEY)
+        numkeys--;
+    *size = footer;
+    return FRAME_TYPE(header);
+}
+
+
+
+static int TopFrameType (void)
+{
+    uint32_t header;
+    uint32_t footer;
+    
+    RingRead(head - sizeof(footer), &footer, sizeof(footer));
+    RingRead(head - sizeof(footer) - footer - sizeof(header), &header, sizeof(header));
+    return FRAME_TYPE(header);
+}
+
+
+
+#pragma mark - State
+
+static void CopyStateTo (byte *dst)
+{
+    worldregion_t *r;
+    int i, count;
+    
+    r = W_Regions(&count);
+    for (i=0 ; i<count ; i++, r++)
+    {
+        memcpy(dst, r->data, r->size);
+        dst += r->size;
+    }
+}
+
+
+static void CopyStateFrom (const byte *src)
+{
+    worldregion_t *r;
+    int i, count;
+    
+    r = W_Regions(&count);
+    for (i=0 ; i<count ; i++, r++)
+    {
+        memcpy(r->data, src, r->size);
+        src += r->size;
+    }
+}
+
+
+//
+//  WordAt
+//  Pointer to the live state word at a (whole state) word offset
+//
+static uint32_t *WordAt (uint32_t offset)
+{
+    worldregion_t *r;
+    int i, count;
+    
+    r = W_Regions(&count);
+    for (i=0 ; i<count ; i++, r++)
+    {
+        if (offset < r->size / 4)
+            return (uint32_t *)r->data + offset;
+        offset -= r->size / 4;
+    }
+    
+    return NULL;
+}
+
+
+//
+//  BuildDelta
+//  Write runs of changed words (with their old values) into scratch
+//  and set size. Returns false if the delta wouldn't be smaller than
+//  the whole state.
+//
+static bool BuildDelta (size_t *size)
+{
+    worldregion_t * r;
+    uint32_t *      cur;
+    uint32_t *      old;
+    uint32_t *      out;
+    uint32_t *      end;
+    uint32_t        base;
+    uint32_t        i, j, n;
+    int             k, count;
+    
+    out = (uint32_t *)scratch;
+    end = (uint32_t *)(scratch + statesize);
+    old = (uint32_t *)prev;
+    base = 0;
+    
+    r = W_Regions(&count);
+    for (k=0 ; k<count ; k++, r++)
+    {
+        cur = r->data;
+        n = (uint32_t)(r->size / 4);
+        
+        i = 0;
+        while (i < n)
+        {
+            // most of the state is unchanged, skip it in blocks
+            if ((i & 15) == 0 && i + 16 <= n && !memcmp(cur + i, old + i, 64)) {
+                i += 16;
+                continue;
+            }
+            if (cur[i] == old[i]) {
+                i++;
+                continue;
+            }
+            
+            j = i;
+            while (j < n && cur[j] != old[j])
+                j++;
+            
+            if (out + 2 + (j - i) > end)
+                return false;
+            *out++ = base + i;
+            *out++ = j - i;
+            memcpy(out, old + i, (j - i) * 4);
+            out += j - i;
+            i = j;
+        }
+        
+        old += n;
+        base += n;
+    }
+    
+    *size = (byte *)out - scratch;
+    return true;
+}
+
+
+//
+//  UpdatePrev
+//  Copy the words that changed in the delta into prev
+//
+static void UpdatePrev (size_t size)
+{
+    uint32_t *in;
+    uint32_t *end;
+    uint32_t offset, len;
+    
+    in = (uint32_t *)scratch;
+    end = (uint32_t *)(scratch + size);
+    while (in < end)
+    {
+        offset = *in++;
+        len = *in++;
+        memcpy(prev + offset * 4, WordAt(offset), len * 4);
+        in += len;
+    }
+}
+
+
+//
+//  UndoDelta
+//  Write the old words in a delta back into the live state and prev
+//
+static void UndoDelta (size_t size)
+{
+    uint32_t *in;
+    uint32_t *end;
+    uint32_t offset, len;
+    
+    in = (uint32_t *)scratch;
+    end = (uint32_t *)(scratch + size);
+    while (in < end)
+    {
+        offset = *in++;
+        len = *in++;
+        memcpy(WordAt(offset), in, len * 4);
+        memcpy(prev + offset * 4, in, len * 4);
+        in += len;
+    }
+}
+
+
+static void RestoreFullState (void)
+{
+    CopyStateFrom(scratch);
+    memcpy(prev, scratch, statesize);
+}
+
+
+
+#pragma mark -
+
+void R_Init (void)
+{
+    worldregion_t *r;
+    int i, count;
+    int seconds, megabytes, keyseconds;
+    
+    r = W_Regions(&count);
+    for (i=0 ; i<count ; i++)
+    {
+        if (r[i].size % 4)
+            Quit("R_Init: world regions must be whole words");
+    }
+    
+    seconds = REWIND_SECONDS;
+    megabytes = REWIND_MEGABYTES;
+    keyseconds = REWIND_KEYFRAME_SECONDS;
+    if ((i = CheckParameter("-rewind")) && i + 1 < myargc)
+        seconds = atoi(myargv[i + 1]);
+    if ((i = CheckParameter("-rewindmb")) && i + 1 < myargc)
+        megabytes = atoi(myargv[i + 1]);
+    if ((i = CheckParameter("-rewindkey")) && i + 1 < myargc)
+        keyseconds = atoi(myargv[i + 1]);
+    
+    statesize = W_StateSize();
+    ringsize = (size_t)megabytes * 1024 * 1024;
+    maxframes = seconds * TICS_PER_SECOND;
+    keyinterval = keyseconds * TICS_PER_SECOND;
+    
+    // keyframes are only worth it if plenty of them fit
+    if (statesize * 4 > ringsize)
+        keyinterval = 0;
+    
+    if (!ringsize || !maxframes)
+        return; // rewind off
+    
+    ring = Mem_Alloc(MEM_WORLD, ringsize);
+    prev = Mem_Alloc(MEM_WORLD, statesize);
+    scratch = Mem_Alloc(MEM_WORLD, statesize);
+    if (!ring || !prev || !scratch)
+        Quit("R_Init: could not alloc rewind buffers");
+    maxframes += keyinterval ? maxframes / keyinterval + 1 : 0;
+    
+    LogInfo("rewind: %d s of history in %d MB, keyframe every %d s, state %zu bytes",
+            seconds, megabytes, keyseconds, statesize);
+}
+
+
+//
+//  R_Reset
+//  Forget all history, the current state is the new starting point
+//
+void R_Reset (void)
+{
+    if (!ring)
+        return;
+    
+    head = tail = 0;
+    numframes = numkeys = 0;
+    sincekey = 0;
+    CopyStateTo(prev);
+}
+
+
+//
+//  R_RecordTick
+//  Call after each simulated tick
+//
+void R_RecordTick (void)
+{
+    size_t size;
+    
+    if (!ring)
+        return;
+    
+    if (BuildDelta(&size))
+    {
+        PushFrame(FRAME_DELTA, scratch, size);
+        UpdatePrev(size);
+    }
+    else
+    {
+        PushFrame(FRAME_UNDO, prev, statesize);
+        CopyStateTo(prev);
+    }
+    
+    if (keyinterval && ++sincekey >= keyinterval)
+    {
+        PushFrame(FRAME_KEY, prev, statesize);
+        sincekey = 0;
+    }
+}
+
+
+//
+//  R_StepBack
+//  Undo the newest recorded tick, returns false if there is no history
+//
+bool R_StepBack (void)
+{
+    size_t size;
+    int type;
+    
+    if (!ring)
+        return false;
+    
+    do
+        type = PopFrame(&size);
+    while (type == FRAME_KEY);
+    
+    switch (type)
+    {
+        case FRAME_DELTA:
+            UndoDelta(size);
+            break;
+        case FRAME_UNDO:
+            RestoreFullState();
+            break;
+        default:
+            return false;
+    }
+    
+    return true;
+}
+
+
+//
+//  R_JumpBack
+//  Go straight back to the previous keyframe
+//
+bool R_JumpBack (void)
+{
+    size_t size;
+    bool moved;
+    int type;
+    
+    if (!ring || !numkeys)
+        return false;
+    if (numkeys == 1 && TopFrameType() == FRAME_KEY)
+        return false; // already there, and there's nothing older
+    
+    moved = false;
+    while ((type = PopFrame(&size)) != -1)
+    {
+        if (type != FRAME_KEY) {
+            moved = true;
+            continue;
+        }
+        if (!moved)
+            continue; // sitting on this one, go to the one before
+        
+        RestoreFullState();
+        sincekey = 0;
+        return true;
+    }
+    
+    return false;
+}
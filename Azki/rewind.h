@@ -0,0 +1,28 @@
+//
+//  rewind.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef rewind_h
+#define rewind_h
+
+#include <stdbool.h>
+
+#define TICS_PER_SECOND         60
+
+// defaults, override with -rewind <seconds>, -rewindmb <megabytes>
+// and -rewindkey <seconds>
+#define REWIND_SECONDS          60
+#define REWIND_MEGABYTES        8
+#define REWIND_KEYFRAME_SECONDS 20
+
+void R_Init (void);
+void R_Reset (void);
+void R_RecordTick (void);
+bool R_StepBack (void);
+bool R_JumpBack (void);
+
+#endif /* rewind_h */
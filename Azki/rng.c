@@ -0,0 +1,582 @@
+//
+//  rng.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Random number streams: xoshiro128++ (Blackman and Vigna), 16 bytes of
+//  state, seeded from a 64-bit value through SplitMix64. A stream can be
+//  split into a new one seeded from its output, or jumped ahead 2^64
+//  draws to get a stream that can't overlap it.
+//
+//  A batch is RNG_LANES streams a jump apart, stored word by word so a
+//  bulk fill steps all of them at once with vector operations.
+//
+//  Philox4x32-10 (Salmon et al.) has no state at all: it's a keyed
+//  function of a 128-bit counter, so a number can be drawn for any
+//  (seed, tick, entity, draw) in any order and always comes out the same.
+//
+//  Rng_SelfTest and Rng_Benchmark back the -rngtest option.
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rng.h"
+#include "log.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define RNG_VECTOR
+    typedef uint32_t vec_t __attribute__((vector_size(RNG_LANES * 4)));
+#endif
+
+static const uint32_t jump[4] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+
+
+
+#pragma mark - Streams
+
+static inline uint32_t Rotl (uint32_t x, int k)
+{
+    return x << k | x >> (32 - k);
+}
+
+
+static uint64_t SplitMix64 (uint64_t *x)
+{
+    uint64_t z;
+
+    z = (*x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+
+void Rng_Seed (rng_t *rng, uint64_t seed)
+{
+    uint64_t a, b;
+
+    a = SplitMix64(&seed);
+    b = SplitMix64(&seed);
+    rng->s[0] = (uint32_t)a;
+    rng->s[1] = (uint32_t)(a >> 32);
+    rng->s[2] = (uint32_t)b;
+    rng->s[3] = (uint32_t)(b >> 32);
+    if (!(rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]))
+        rng->s[0] = 1; // all zero is the one state that never leaves
+}
+
+
+uint32_t Rng_Next (rng_t *rng)
+{
+    uint32_t *s;
+    uint32_t result, t;
+
+    s = rng->s;
+    result = Rotl(s[0] + s[3], 7) + s[0];
+    t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = Rotl(s[3], 11);
+
+    return result;
+}
+
+
+//
+//  Rng_Split
+//  Seed child from rng's output, for a stream of its own
+//
+void Rng_Split (rng_t *rng, rng_t *child)
+{
+    uint64_t seed;
+
+    seed = (uint64_t)Rng_Next(rng) << 32;
+    seed |= Rng_Next(rng);
+    Rng_Seed(child, seed);
+}
+
+
+//
+//  Rng_Jump
+//  Advance rng 2^64 draws
+//
+void Rng_Jump (rng_t *rng)
+{
+    uint32_t s[4];
+    int i, b;
+
+    memset(s, 0, sizeof(s));
+    for (i=0 ; i<4 ; i++)
+    {
+        for (b=0 ; b<32 ; b++)
+        {
+            if (jump[i] & 1u << b) {
+                s[0] ^= rng->s[0];
+                s[1] ^= rng->s[1];
+                s[2] ^= rng->s[2];
+                s[3] ^= rng->s[3];
+            }
+            Rng_Next(rng);
+        }
+    }
+    memcpy(rng->s, s, sizeof(s));
+}
+
+
+//
+//  Rng_Range
+//  0...n-1 without modulo bias (Lemire)
+//
+uint32_t Rng_Range (rng_t *rng, uint32_t n)
+{
+    uint64_t m;
+    uint32_t low, threshold;
+
+    m = (uint64_t)Rng_Next(rng) * n;
+    low = (uint32_t)m;
+    if (low < n)
+    {
+        threshold = -n % n;
+        while (low < threshold) {
+            m = (uint64_t)Rng_Next(rng) * n;
+            low = (uint32_t)m;
+        }
+    }
+    return m >> 32;
+}
+
+
+
+#pragma mark - Counters
+
+#define PHILOX_M0       0xD2511F53
+#define PHILOX_M1       0xCD9E8D57
+#define PHILOX_W0       0x9E3779B9
+#define PHILOX_W1       0xBB67AE85
+#define PHILOX_ROUNDS   10
+
+//
+//  Rng_Philox
+//  Philox4x32-10 of counter with key
+//
+void Rng_Philox (const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0, c1, c2, c3, k0, k1;
+    uint64_t p0, p1;
+    int r;
+
+    c0 = counter[0];
+    c1 = counter[1];
+    c2 = counter[2];
+    c3 = counter[3];
+    k0 = key[0];
+    k1 = key[1];
+    for (r=0 ; r<PHILOX_ROUNDS ; r++)
+    {
+        p0 = (uint64_t)PHILOX_M0 * c0;
+        p1 = (uint64_t)PHILOX_M1 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+
+//
+//  Rng_Counter
+//  One number for the counter c0...c3 under a 64-bit key
+//
+uint32_t Rng_Counter (uint64_t key, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3)
+{
+    uint32_t counter[4] = { c0, c1, c2, c3 };
+    uint32_t k[2] = { (uint32_t)key, (uint32_t)(key >> 32) };
+    uint32_t out[4];
+
+    Rng_Philox(counter, k, out);
+    return out[0];
+}
+
+
+
+#pragma mark - Batches
+
+//
+//  Rng_InitBatch
+//  Lanes from a stream split off rng, each a jump past the last. rng
+//  isn't changed.
+//
+void Rng_InitBatch (rngbatch_t *batch, const rng_t *rng)
+{
+    rng_t parent, lane;
+    int i, w;
+
+    parent = *rng;
+    Rng_Split(&parent, &lane);
+    for (i=0 ; i<RNG_LANES ; i++)
+    {
+        for (w=0 ; w<4 ; w++)
+            batch->s[w][i] = lane.s[w];
+        Rng_Jump(&lane);
+    }
+}
+
+
+#ifdef RNG_VECTOR
+
+// one draw from every lane
+static inline vec_t StepBatch (vec_t s[4])
+{
+    vec_t result, t;
+
+    result = s[0] + s[3];
+    result = (result << 7 | result >> 25) + s[0];
+    t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = s[3] << 11 | s[3] >> 21;
+
+    return result;
+}
+
+
+//
+//  Rng_Fill
+//  n numbers, RNG_LANES at a time: buf[i] is from lane i % RNG_LANES
+//
+void Rng_Fill (rngbatch_t *batch, uint32_t *buf, size_t n)
+{
+    vec_t s[4], result;
+    int w;
+
+    for (w=0 ; w<4 ; w++)
+        memcpy(&s[w], batch->s[w], sizeof(s[w]));
+
+    for ( ; n >= RNG_LANES ; n -= RNG_LANES, buf += RNG_LANES)
+    {
+        result = StepBatch(s);
+        memcpy(buf, &result, sizeof(result));
+    }
+    if (n)
+    {
+        result = StepBatch(s);
+        memcpy(buf, &result, n * sizeof(*buf));
+    }
+
+    for (w=0 ; w<4 ; w++)
+        memcpy(batch->s[w], &s[w], sizeof(s[w]));
+}
+
+#else
+
+void Rng_Fill (rngbatch_t *batch, uint32_t *buf, size_t n)
+{
+    uint32_t result[RNG_LANES];
+    rng_t lane;
+    size_t i;
+    int l, w;
+
+    for (i=0 ; i<n ; i+=RNG_LANES)
+    {
+        for (l=0 ; l<RNG_LANES ; l++)
+        {
+            for (w=0 ; w<4 ; w++)
+                lane.s[w] = batch->s[w][l];
+            result[l] = Rng_Next(&lane);
+            for (w=0 ; w<4 ; w++)
+                batch->s[w][l] = lane.s[w];
+        }
+        memcpy(buf + i, result, (n - i < RNG_LANES ? n - i : RNG_LANES) * sizeof(*buf));
+    }
+}
+
+#endif
+
+
+
+#pragma mark - Testing
+
+#define TEST_DRAWS      (1 << 20)
+#define BENCH_DRAWS     (1 << 24)
+#define BENCH_CHUNK     4096
+
+static bool Check (bool ok, const char *name)
+{
+    if (ok)
+        LogInfo("Rng_SelfTest: %s ok", name);
+    else
+        LogError("Rng_SelfTest: %s FAILED", name);
+    return ok;
+}
+
+
+// chi-square of the counts against a flat distribution
+static double ChiSquare (const uint32_t *counts, int bins, uint32_t total)
+{
+    double expected, chi, d;
+    int i;
+
+    expected = (double)total / bins;
+    chi = 0;
+    for (i=0 ; i<bins ; i++) {
+        d = counts[i] - expected;
+        chi += d * d / expected;
+    }
+    return chi;
+}
+
+
+// chi-square above which a fair generator fails about once in 10^5 runs
+static double ChiLimit (int bins)
+{
+    double df = bins - 1;
+    return df + 6.0 * sqrt(2.0 * df);
+}
+
+
+//
+//  Rng_SelfTest
+//  Known answers, batches against single streams, and some simple
+//  statistics: bit balance, byte and range uniformity
+//
+bool Rng_SelfTest (void)
+{
+    // xoshiro128++ from state 1, 2, 3, 4
+    static const uint32_t known[6] =
+    {
+        0x00000281, 0x00180387, 0xc0183387, 0xd1ae3b02, 0x31e2310a, 0xfd275ab0
+    };
+    static uint32_t buf[TEST_DRAWS];
+    uint32_t        bits[32];
+    uint32_t        low[256], high[256], range[7];
+    rng_t           rng, lanes[RNG_LANES], child;
+    rngbatch_t      batch;
+    bool            ok, match;
+    int             i, b, l, w, same;
+    uint32_t        x, spread;
+
+    ok = true;
+
+    rng = (rng_t){ { 1, 2, 3, 4 } };
+    match = true;
+    for (i=0 ; i<6 ; i++)
+        match &= Rng_Next(&rng) == known[i];
+    ok &= Check(match, "known answers");
+
+    // Philox4x32-10 known answers from Random123
+    {
+        static const uint32_t counters[3][4] =
+        {
+            { 0, 0, 0, 0 },
+            { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+            { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }
+        };
+        static const uint32_t keys[3][2] =
+        {
+            { 0, 0 },
+            { 0xffffffff, 0xffffffff },
+            { 0xa4093822, 0x299f31d0 }
+        };
+        static const uint32_t answers[3][4] =
+        {
+            { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+            { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+            { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }
+        };
+        uint32_t out[4];
+
+        match = true;
+        for (i=0 ; i<3 ; i++) {
+            Rng_Philox(counters[i], keys[i], out);
+            match &= !memcmp(out, answers[i], sizeof(out));
+        }
+        ok &= Check(match, "Philox known answers");
+    }
+
+    // a fill is each lane stepped on its own
+    Rng_Seed(&rng, 12345);
+    Rng_InitBatch(&batch, &rng);
+    for (l=0 ; l<RNG_LANES ; l++)
+        for (w=0 ; w<4 ; w++)
+            lanes[l].s[w] = batch.s[w][l];
+    Rng_Fill(&batch, buf, 1003);
+    match = true;
+    for (i=0 ; i<1003 ; i++)
+        match &= buf[i] == Rng_Next(&lanes[i % RNG_LANES]);
+    ok &= Check(match, "batch fill matches streams");
+
+    // split and jumped streams differ from their parent
+    Rng_Seed(&rng, 12345);
+    Rng_Split(&rng, &child);
+    lanes[0] = rng;
+    Rng_Jump(&lanes[0]);
+    same = 0;
+    for (i=0 ; i<1024 ; i++) {
+        x = Rng_Next(&rng);
+        same += x == Rng_Next(&child);
+        same += x == Rng_Next(&lanes[0]);
+    }
+    ok &= Check(same == 0, "split and jump");
+
+    // statistics on a bulk fill
+    Rng_Seed(&rng, 0x5eed);
+    Rng_InitBatch(&batch, &rng);
+    Rng_Fill(&batch, buf, TEST_DRAWS);
+    memset(bits, 0, sizeof(bits));
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    for (i=0 ; i<TEST_DRAWS ; i++)
+    {
+        x = buf[i];
+        low[x & 0xFF]++;
+        high[x >> 24]++;
+        for (b=0 ; b<32 ; b++)
+            bits[b] += x >> b & 1;
+    }
+
+    // each bit set half the time, within 5 standard deviations
+    spread = 5 * (uint32_t)sqrt(TEST_DRAWS) / 2;
+    match = true;
+    for (b=0 ; b<32 ; b++)
+        match &= bits[b] > TEST_DRAWS / 2 - spread && bits[b] < TEST_DRAWS / 2 + spread;
+    ok &= Check(match, "bit balance");
+
+    ok &= Check(ChiSquare(low, 256, TEST_DRAWS) < ChiLimit(256)
+                && ChiSquare(high, 256, TEST_DRAWS) < ChiLimit(256), "byte uniformity");
+
+    // counters that differ in one word still look independent
+    memset(low, 0, sizeof(low));
+    for (i=0 ; i<TEST_DRAWS ; i++)
+        low[Rng_Counter(0x5eed, i & 7, i >> 3 & 0xFF, i >> 11, 0) & 0xFF]++;
+    ok &= Check(ChiSquare(low, 256, TEST_DRAWS) < ChiLimit(256), "counter uniformity");
+
+    memset(range, 0, sizeof(range));
+    for (i=0 ; i<TEST_DRAWS ; i++)
+        range[Rng_Range(&rng, 7)]++;
+    ok &= Check(ChiSquare(range, 7, TEST_DRAWS) < ChiLimit(7), "range uniformity");
+
+    return ok;
+}
+
+
+
+#pragma mark - Benchmark
+
+// the complementary multiply with carry generator Random used before
+#define CMWC_CYCLE      4096
+#define CMWC_C_MAX      809430660
+
+static struct
+{
+    uint32_t    Q[CMWC_CYCLE];
+    uint32_t    c;
+    unsigned    ri;
+} cmwc;
+
+
+static void SeedCMWC (unsigned int seed)
+{
+    int i;
+
+    srand(seed);
+    for (i=0 ; i<CMWC_CYCLE ; i++)
+        cmwc.Q[i] = (uint32_t)rand() << 16 | rand();
+    do
+        cmwc.c = (uint32_t)rand() << 16 | rand();
+    while (cmwc.c >= CMWC_C_MAX);
+    cmwc.ri = CMWC_CYCLE - 1;
+}
+
+
+static uint32_t NextCMWC (void)
+{
+    uint64_t const a = 18782;
+    uint32_t const m = 0xfffffffe;
+    uint64_t t;
+    uint32_t x;
+
+    cmwc.ri = (cmwc.ri + 1) & (CMWC_CYCLE - 1);
+    t = a * cmwc.Q[cmwc.ri] + cmwc.c;
+    cmwc.c = t >> 32;
+    x = (uint32_t)(t + cmwc.c);
+    if (x < cmwc.c) {
+        x++;
+        cmwc.c++;
+    }
+    return cmwc.Q[cmwc.ri] = m - x;
+}
+
+
+static double Seconds (Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+
+//
+//  Rng_Benchmark
+//  Log seeding and draw rates of the old generator and the new ones
+//
+void Rng_Benchmark (void)
+{
+    static uint32_t buf[BENCH_CHUNK];
+    volatile uint32_t sink;
+    rngbatch_t  batch;
+    rng_t       rng;
+    Uint64      start;
+    uint32_t    sum;
+    int         i;
+
+    start = SDL_GetPerformanceCounter();
+    for (i=0 ; i<100 ; i++)
+        SeedCMWC(i);
+    LogInfo("Rng_Benchmark: CMWC seed     %8.2f us", Seconds(start) * 1e6 / 100);
+
+    start = SDL_GetPerformanceCounter();
+    for (i=0 ; i<100 ; i++)
+        Rng_Seed(&rng, i);
+    LogInfo("Rng_Benchmark: xoshiro seed  %8.2f us", Seconds(start) * 1e6 / 100);
+
+    sum = 0;
+    start = SDL_GetPerformanceCounter();
+    for (i=0 ; i<BENCH_DRAWS ; i++)
+        sum += NextCMWC();
+    LogInfo("Rng_Benchmark: CMWC          %8.1f M/s", BENCH_DRAWS / Seconds(start) / 1e6);
+
+    start = SDL_GetPerformanceCounter();
+    for (i=0 ; i<BENCH_DRAWS ; i++)
+        sum += Rng_Next(&rng);
+    LogInfo("Rng_Benchmark: xoshiro       %8.1f M/s", BENCH_DRAWS / Seconds(start) / 1e6);
+
+    Rng_InitBatch(&batch, &rng);
+    start = SDL_GetPerformanceCounter();
+    for (i=0 ; i<BENCH_DRAWS ; i+=BENCH_CHUNK) {
+        Rng_Fill(&batch, buf, BENCH_CHUNK);
+        sum += buf[i & (BENCH_CHUNK - 1)];
+    }
+    LogInfo("Rng_Benchmark: xoshiro fill  %8.1f M/s (%d lanes)",
+            BENCH_DRAWS / Seconds(start) / 1e6, RNG_LANES);
+
+    start = SDL_GetPerformanceCounter();
+    for (i=0 ; i<BENCH_DRAWS / 16 ; i++)
+        sum += Rng_Counter(1, i, 2, 3, 4);
+    LogInfo("Rng_Benchmark: Philox        %8.1f M/s", BENCH_DRAWS / 16 / Seconds(start) / 1e6);
+
+    sink = sum;
+    (void)sink;
+}
@@ -0,0 +1,45 @@
+//
+//  rng.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef rng_h
+#define rng_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RNG_LANES       4       // streams a batch runs side by side
+
+// a xoshiro128++ stream
+typedef struct
+{
+    uint32_t    s[4];
+} rng_t;
+
+// RNG_LANES streams, 2^64 draws apart, for bulk fills
+typedef struct
+{
+    uint32_t    s[4][RNG_LANES];    // word, then lane
+} rngbatch_t;
+
+void     Rng_Seed (rng_t *rng, uint64_t seed);
+void     Rng_Split (rng_t *rng, rng_t *child);
+void     Rng_Jump (rng_t *rng);
+uint32_t Rng_Next (rng_t *rng);
+uint32_t Rng_Range (rng_t *rng, uint32_t n);
+
+void     Rng_Philox (const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+uint32_t Rng_Counter (uint64_t key, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3);
+
+void     Rng_InitBatch (rngbatch_t *batch, const rng_t *rng);
+void     Rng_Fill (rngbatch_t *batch, uint32_t *buf, size_t n);
+
+bool     Rng_SelfTest (void);
+void     Rng_Benchmark (void);
+
+#endif /* rng_h */
@@ -11,6 +11,7 @@
 #include "azki.h"
 #include "player.h"
 #include "map.h"
+#include "watch.h"
 
 char deathmsg[80];
 
@@ -40,6 +41,7 @@ void S_Level ()
                     }
                     return;
                 default:
+                    Watch_HandleEvent(&event);
                     break;
             }
         }
@@ -83,6 +85,7 @@ void S_GameOver ()
                     }
                     break;
                 default:
+                    Watch_HandleEvent(&event);
                     break;
             }
         }
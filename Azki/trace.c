@@ -0,0 +1,234 @@
+//
+//  trace.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Timed zones written as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+//  TraceBegin and TraceEnd record an event into the calling thread's own
+//  ring, so threads never wait on each other; a ring only overwrites its
+//  oldest events, and Trace_Stop writes every ring's events to the file.
+//  A zone whose begin was overwritten is left out, and one still open at
+//  the stop is ended there, so the file's zones always balance.
+//  Zone names must outlive the trace, string literals or static tables.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "trace.h"
+#include "mem.h"
+#include "log.h"
+
+#define TRACE_DEPTH     64      // open zones per thread that can be closed at the stop
+
+typedef struct
+{
+    uint64_t        time;       // performance counter
+    const char *    name;
+    char            phase;      // 'B'egin or 'E'nd
+} traceevent_t;
+
+typedef struct
+{
+    int             tid;
+    const char *    name;
+    uint32_t        head;       // events ever recorded, only its thread writes
+    uint32_t        start;      // head when this trace started
+    traceevent_t *  events;
+} tracering_t;
+
+bool tracing;
+
+static char         tracepath[256] = TRACE_FILE;
+static uint64_t     tracestart;
+static SDL_TLSID    ringkey;
+static tracering_t  rings[TRACE_THREADS];
+static int          numrings;
+static SDL_atomic_t dropped;    // events from threads without a ring
+static SDL_SpinLock lock;
+
+
+
+//
+//  GetRing
+//  The calling thread's ring, set up on its first event
+//
+static tracering_t *GetRing (const char *name)
+{
+    tracering_t *r;
+
+    r = SDL_TLSGet(ringkey);
+    if (r)
+        return r;
+
+    SDL_AtomicLock(&lock);
+    if (numrings < TRACE_THREADS)
+    {
+        r = &rings[numrings];
+        r->events = Mem_Alloc(MEM_MISC, TRACE_RING * sizeof(r->events[0]));
+        if (r->events) {
+            r->tid = ++numrings;
+            r->name = name;
+            r->head = 0;
+            r->start = 0;
+        } else {
+            r = NULL;
+        }
+    }
+    SDL_AtomicUnlock(&lock);
+
+    if (r)
+        SDL_TLSSet(ringkey, r, NULL);
+    return r;
+}
+
+
+void Trace_Event (const char *name, char phase)
+{
+    tracering_t *r;
+    traceevent_t *e;
+
+    r = GetRing("worker");
+    if (!r) {
+        SDL_AtomicAdd(&dropped, 1);
+        return;
+    }
+
+    e = &r->events[r->head % TRACE_RING];
+    e->time = SDL_GetPerformanceCounter();
+    e->name = name;
+    e->phase = phase;
+    SDL_MemoryBarrierRelease();
+    r->head++;
+}
+
+
+
+#pragma mark -
+
+//
+//  Trace_Start
+//  Start recording, to be written to path (or the last one) when stopped
+//
+void Trace_Start (const char *path)
+{
+    int i;
+
+    if (path) {
+        strncpy(tracepath, path, sizeof(tracepath) - 1);
+        tracepath[sizeof(tracepath) - 1] = '\0';
+    }
+    if (tracing)
+        return;
+
+    if (!ringkey)
+        ringkey = SDL_TLSCreate();
+
+    // each thread's head is its own, just note where this trace starts
+    SDL_AtomicLock(&lock);
+    for (i=0 ; i<numrings ; i++)
+        rings[i].start = rings[i].head;
+    SDL_AtomicUnlock(&lock);
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&dropped, 0);
+
+    GetRing("main"); // now, not in a frame
+    tracestart = SDL_GetPerformanceCounter();
+    tracing = true;
+    LogInfo("Trace: recording to %s", tracepath);
+}
+
+
+static void WriteName (FILE *f, const char *name)
+{
+    for ( ; *name ; name++)
+    {
+        if (*name == '"' || *name == '\\')
+            fputc('\\', f);
+        fputc(*name, f);
+    }
+}
+
+
+static void WriteEvent (FILE *f, const tracering_t *r, const char *name,
+                        char phase, uint64_t time, double scale)
+{
+    fprintf(f, ",\n{\"name\":\"");
+    WriteName(f, name);
+    fprintf(f, "\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+            phase, r->tid, (time - tracestart) * scale);
+}
+
+
+//
+//  Trace_Stop
+//  Stop recording and write the file
+//
+void Trace_Stop (void)
+{
+    FILE *f;
+    tracering_t *r;
+    traceevent_t *e;
+    uint32_t head, first, i;
+    const char *open[TRACE_DEPTH];
+    uint64_t last;
+    double scale;
+    int count, depth;
+
+    if (!tracing)
+        return;
+    tracing = false;
+
+    f = fopen(tracepath, "w");
+    if (!f) {
+        LogError("Trace: couldn't write %s", tracepath);
+        return;
+    }
+
+    scale = 1000000.0 / SDL_GetPerformanceFrequency();
+    count = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (r=rings ; r<rings+numrings ; r++)
+    {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", r == rings ? "" : ",\n", r->tid, r->name);
+
+        // another thread may still be finishing an event, take what's done
+        head = r->head;
+        SDL_MemoryBarrierAcquire();
+        first = head - r->start > TRACE_RING ? head - TRACE_RING : r->start;
+        depth = 0;
+        last = tracestart;
+        for (i=first ; i!=head ; i++)
+        {
+            e = &r->events[i % TRACE_RING];
+            if (e->time < tracestart)
+                continue;
+            if (e->phase == 'B') {
+                if (depth < TRACE_DEPTH)
+                    open[depth] = e->name;
+                depth++;
+            } else if (!depth) {
+                continue; // its begin was overwritten
+            } else {
+                depth--;
+            }
+            WriteEvent(f, r, e->name, e->phase, e->time, scale);
+            last = e->time;
+            count++;
+        }
+        
+        // still open at the stop, e.g. the frame that pressed F4
+        while (depth--)
+            WriteEvent(f, r, depth < TRACE_DEPTH ? open[depth] : "?", 'E', last, scale);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    LogInfo("Trace: wrote %d events to %s", count, tracepath);
+    if (SDL_AtomicGet(&dropped))
+        LogWarn("Trace: dropped %d events, over %d threads",
+                SDL_AtomicGet(&dropped), TRACE_THREADS);
+}
@@ -0,0 +1,37 @@
+//
+//  trace.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef trace_h
+#define trace_h
+
+#include <stdbool.h>
+
+#define TRACE_FILE      "trace.json"
+#define TRACE_RING      32768   // events kept per thread, the oldest are dropped
+#define TRACE_THREADS   16
+
+// zones are compiled out with TRACE 0, and cost a branch while not recording
+#ifndef TRACE
+    #define TRACE 1
+#endif
+
+#if TRACE
+    #define TraceBegin(name)    do { if (tracing) Trace_Event(name, 'B'); } while (0)
+    #define TraceEnd(name)      do { if (tracing) Trace_Event(name, 'E'); } while (0)
+#else
+    #define TraceBegin(name)    ((void)0)
+    #define TraceEnd(name)      ((void)0)
+#endif
+
+extern bool tracing;
+
+void Trace_Start (const char *path);
+void Trace_Stop (void);
+void Trace_Event (const char *name, char phase);
+
+#endif /* trace_h */
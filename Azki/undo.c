@@ -0,0 +1,227 @@
+//
+//  undo.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Editor undo history. Each tile change is kept as a 6-byte delta, and
+//  the deltas of one mouse stroke or fill are grouped as a stroke, so the
+//  history costs what was changed rather than copies of the map. When it
+//  grows past the budget the oldest strokes are dropped.
+//
+//  The history is for one map: recording or undoing on another map
+//  clears it. Like the edit journal, only types are kept, so an object
+//  with instance data comes back as a plain one.
+
+#include <stdlib.h>
+#include <string.h>
+#include "undo.h"
+#include "mem.h"
+#include "log.h"
+
+typedef struct
+{
+    int         mapnum;
+    int         first;      // index of its first delta
+    int         count;
+} stroke_t;
+
+static undodelta_t *    deltas;
+static int              numdeltas;
+static int              maxdeltas;
+
+static stroke_t *       strokes;
+static int              numstrokes;
+static int              maxstrokes;
+
+static int              done;       // strokes before this can be undone, the rest redone
+static bool             open;       // the last stroke is still taking changes
+static size_t           budget = UNDO_BUDGET;
+
+
+
+static size_t HistorySize (void)
+{
+    return numdeltas * sizeof(*deltas) + numstrokes * sizeof(*strokes);
+}
+
+
+//
+//  Trim
+//  Drop the oldest strokes until the history fits the budget, always
+//  keeping the newest
+//
+static void Trim (void)
+{
+    int drop, dropdeltas, i;
+
+    for (drop=0 ; drop<numstrokes-1 ; drop++)
+    {
+        if ((numdeltas - strokes[drop].first) * sizeof(*deltas)
+            + (numstrokes - drop) * sizeof(*strokes) <= budget)
+            break;
+    }
+    if (!drop)
+        return;
+
+    dropdeltas = strokes[drop].first;
+    numdeltas -= dropdeltas;
+    numstrokes -= drop;
+    memmove(deltas, deltas + dropdeltas, numdeltas * sizeof(*deltas));
+    memmove(strokes, strokes + drop, numstrokes * sizeof(*strokes));
+    for (i=0 ; i<numstrokes ; i++)
+        strokes[i].first -= dropdeltas;
+    done = done > drop ? done - drop : 0;
+}
+
+
+static bool Grow (void **array, int *max, int needed, size_t size)
+{
+    void *bigger;
+    int newmax;
+
+    if (needed <= *max)
+        return true;
+
+    newmax = *max ? *max * 2 : 256;
+    while (newmax < needed)
+        newmax *= 2;
+    bigger = Mem_Realloc(MEM_EDITOR, *array, newmax * size);
+    if (!bigger)
+        return false;
+    *array = bigger;
+    *max = newmax;
+    return true;
+}
+
+
+//
+//  BeginStroke
+//  Start a stroke, dropping what could be redone
+//
+static bool BeginStroke (int mapnum)
+{
+    if (numstrokes && strokes[0].mapnum != mapnum)
+        Undo_Clear();
+
+    numstrokes = done;
+    numdeltas = done ? strokes[done - 1].first + strokes[done - 1].count : 0;
+    if (!Grow((void **)&strokes, &maxstrokes, numstrokes + 1, sizeof(*strokes)))
+        return false;
+
+    strokes[numstrokes].mapnum = mapnum;
+    strokes[numstrokes].first = numdeltas;
+    strokes[numstrokes].count = 0;
+    done = ++numstrokes;
+    open = true;
+    return true;
+}
+
+
+
+#pragma mark -
+
+void Undo_SetBudget (size_t bytes)
+{
+    budget = bytes;
+    Trim();
+}
+
+
+//
+//  Undo_Record
+//  A tile was changed. Changes until the next Undo_EndStroke are undone
+//  together.
+//
+void Undo_Record (int mapnum, int layer, tile x, tile y, objtype_t oldtype, objtype_t newtype)
+{
+    undodelta_t *delta;
+
+    if (oldtype == newtype)
+        return;
+
+    if ((!open || strokes[numstrokes - 1].mapnum != mapnum) && !BeginStroke(mapnum))
+        goto nomemory;
+    if (!Grow((void **)&deltas, &maxdeltas, numdeltas + 1, sizeof(*deltas)))
+        goto nomemory;
+
+    delta = &deltas[numdeltas++];
+    delta->cell = layer << 15 | (y * MAP_W + x);
+    delta->oldtype = oldtype;
+    delta->newtype = newtype;
+    strokes[numstrokes - 1].count++;
+    return;
+
+nomemory:
+    LogWarn("Undo_Record: out of memory, undo history cleared");
+    Undo_Clear();
+}
+
+
+void Undo_EndStroke (void)
+{
+    if (!open)
+        return;
+
+    open = false;
+    Trim();
+}
+
+
+void Undo_Clear (void)
+{
+    numdeltas = 0;
+    numstrokes = 0;
+    done = 0;
+    open = false;
+}
+
+
+//
+//  Undo_Undo
+//  Returns the changes of the last stroke on mapnum, to be reverted last
+//  to first, or NULL if there's nothing to undo
+//
+const undodelta_t * Undo_Undo (int mapnum, int *count)
+{
+    stroke_t *stroke;
+
+    Undo_EndStroke();
+    if (!done)
+        return NULL;
+
+    stroke = &strokes[--done];
+    if (stroke->mapnum != mapnum) {
+        Undo_Clear();
+        return NULL;
+    }
+
+    LogDebug("Undo_Undo: %d changes, %zu bytes of history", stroke->count, HistorySize());
+    *count = stroke->count;
+    return &deltas[stroke->first];
+}
+
+
+//
+//  Undo_Redo
+//  Returns the changes of the last undone stroke on mapnum, to be
+//  applied first to last, or NULL if there's nothing to redo
+//
+const undodelta_t * Undo_Redo (int mapnum, int *count)
+{
+    stroke_t *stroke;
+
+    Undo_EndStroke();
+    if (done == numstrokes)
+        return NULL;
+
+    stroke = &strokes[done++];
+    if (stroke->mapnum != mapnum) {
+        Undo_Clear();
+        return NULL;
+    }
+
+    *count = stroke->count;
+    return &deltas[stroke->first];
+}
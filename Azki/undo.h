@@ -0,0 +1,38 @@
+//
+//  undo.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef undo_h
+#define undo_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "map.h"
+
+#define UNDO_BUDGET     (1024 * 1024)   // default bytes of history
+
+// one tile change
+typedef struct
+{
+    uint16_t    cell;       // layer << 15 | y * MAP_W + x
+    uint16_t    oldtype;
+    uint16_t    newtype;
+} undodelta_t;
+
+#define UNDO_LAYER(d)   ((d)->cell >> 15)
+#define UNDO_X(d)       (((d)->cell & 0x7FFF) % MAP_W)
+#define UNDO_Y(d)       (((d)->cell & 0x7FFF) / MAP_W)
+
+void Undo_SetBudget (size_t bytes);
+void Undo_Record (int mapnum, int layer, tile x, tile y, objtype_t oldtype, objtype_t newtype);
+void Undo_EndStroke (void);
+void Undo_Clear (void);
+const undodelta_t * Undo_Undo (int mapnum, int *count);
+const undodelta_t * Undo_Redo (int mapnum, int *count);
+
+#endif /* undo_h */
@@ -8,9 +8,14 @@
 //  SDL, graphics, and font
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "video.h"
 #include "map.h"
+#include "mem.h"
+#include "log.h"
+#include "trace.h"
 
 SDL_Window *    window;
 SDL_Renderer *  renderer;
@@ -27,6 +32,7 @@ float fullscreen_scale = 1.0f;
 bool fullscreen = false;
 
 static bool video_started = false;
+static int lightlevel = 255;
 
 static const SDL_Color colors[] =
 {
@@ -51,25 +57,245 @@ static const SDL_Color colors[] =
 };
 
 
-static int frame_start;
-static int dt;
+//
+//  PaletteColor
+//  RGB of palette color c, for drawing without the renderer
+//
+const SDL_Color * PaletteColor (int c)
+{
+    return &colors[c % NUMCOLORS];
+}
+
+
+#define SPIN_MS         2       // sleep to within this of a deadline, then spin
+
+static const char *presentnames[] = { "free", "vsync", "fps" };
+
+// frame pacing and its stats since the last report
+static struct
+{
+    presentmode_t   mode;
+    int             fps;        // PRESENT_FPS target
+    int             refresh;    // display rate for PRESENT_VSYNC
+    
+    Uint64          freq;
+    Uint64          period;     // counts per frame
+    Uint64          start;      // this frame's work started
+    Uint64          deadline;   // this frame should be presented by
+    Uint64          last;       // the last frame ended, 0 after a break
+    
+    Uint64          tickclock;  // game time accounted up to, 0 to start afresh
+    Uint64          owed;       // counts of game time not yet ticked
+    
+    int             frames;
+    int             missed;
+    double          jitter;     // sum of |interval - period|, ms
+    double          maxjitter;
+    float           work[PRESENT_REPORT];   // ms of each frame before pacing
+} pacing;
+
+
+//
+//  SetPresentMode
+//  Call before StartVideo. fps is the target rate for PRESENT_FPS.
+//
+void SetPresentMode (presentmode_t mode, int fps)
+{
+    pacing.mode = mode;
+    pacing.fps = fps;
+}
+
+
+static double Milliseconds (Uint64 counts)
+{
+    return counts * 1000.0 / pacing.freq;
+}
+
+
+//
+//  SleepUntil
+//  SDL_Delay is only good to a millisecond or two, so sleep short of
+//  deadline and spin the rest
+//
+static void SleepUntil (Uint64 deadline)
+{
+    Uint64 now;
+    double left;
+    
+    while ((now = SDL_GetPerformanceCounter()) < deadline)
+    {
+        left = Milliseconds(deadline - now);
+        if (left > SPIN_MS)
+            SDL_Delay((Uint32)left - SPIN_MS + 1);
+    }
+}
+
+
+static int CompareWork (const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    
+    return (x > y) - (x < y);
+}
+
+
+static void ReportPacing (void)
+{
+    float *w;
+    int n;
+    double budget;
+    
+    n = pacing.frames;
+    w = pacing.work;
+    budget = Milliseconds(pacing.period);
+    qsort(w, n, sizeof(*w), CompareWork);
+    
+    LogInfo("present %s: %d frames at %.2f ms, work p50 %.2f p99 %.2f max %.2f ms "
+            "(%d%% of budget), jitter mean %.3f max %.3f ms, %d missed",
+            presentnames[pacing.mode], n, budget,
+            w[n / 2], w[(n - 1) * 99 / 100], w[n - 1],
+            (int)(w[(n - 1) * 99 / 100] * 100 / budget),
+            pacing.jitter / n, pacing.maxjitter, pacing.missed);
+    
+    pacing.frames = 0;
+    pacing.missed = 0;
+    pacing.jitter = 0;
+    pacing.maxjitter = 0;
+}
+
 
 void StartFrame (void)
 {
-    frame_start = SDL_GetTicks();
+    pacing.start = SDL_GetPerformanceCounter();
+    
+    // something outside a frame loop ran, e.g. a menu: don't count the gap
+    if (pacing.last && pacing.start - pacing.last > pacing.period)
+        pacing.last = 0;
 }
 
+
+//
+//  LimitFrameRate
+//  Call after presenting. Waits out the rest of the frame, unless vsync
+//  already has, and returns the ms the frame took before that.
+//
 int LimitFrameRate (int ms_per_frame)
 {
-    dt = SDL_GetTicks() - frame_start;
-    if (dt < ms_per_frame)
-        SDL_Delay(ms_per_frame - dt);
-    else if (dt > 30)
-        printf("frame took %d ms!\n", dt);
+    Uint64 now, interval;
+    double work, jitter;
+    
+    if (!pacing.freq)
+        pacing.freq = SDL_GetPerformanceFrequency();
+    
+    switch (pacing.mode)
+    {
+        case PRESENT_VSYNC:
+            pacing.period = pacing.freq / pacing.refresh;
+            break;
+        case PRESENT_FPS:
+            pacing.period = pacing.freq / pacing.fps;
+            break;
+        default:
+            pacing.period = pacing.freq * ms_per_frame / 1000;
+            break;
+    }
+    
+    now = SDL_GetPerformanceCounter();
+    work = Milliseconds(now - pacing.start);
+    if (work > 30)
+        LogDebug("frame took %.1f ms!", work);
+    
+    if (pacing.mode != PRESENT_VSYNC)
+    {
+        // keep to a fixed schedule, so a late frame doesn't push back
+        // the ones after it
+        if (!pacing.last)
+            pacing.deadline = pacing.start + pacing.period;
+        else
+            pacing.deadline += pacing.period;
+        
+        if (now <= pacing.deadline) {
+            SleepUntil(pacing.deadline);
+        } else {
+            pacing.missed += pacing.last != 0;
+            if (now > pacing.deadline + pacing.period)
+                pacing.deadline = now; // too far behind to catch up
+        }
+        now = SDL_GetPerformanceCounter();
+    }
+    
+    if (pacing.last)
+    {
+        interval = now - pacing.last;
+        if (pacing.mode == PRESENT_VSYNC && interval > pacing.period * 3 / 2)
+            pacing.missed++; // a refresh went by
+        
+        jitter = fabs(Milliseconds(interval) - Milliseconds(pacing.period));
+        pacing.jitter += jitter;
+        if (jitter > pacing.maxjitter)
+            pacing.maxjitter = jitter;
+        
+        pacing.work[pacing.frames++] = (float)work;
+        if (pacing.frames == PRESENT_REPORT)
+            ReportPacing();
+    }
+    pacing.last = now;
+    
+    return (int)work;
+}
+
+
+//
+//  StartTicks
+//  A play loop is starting: time spent before it, e.g. in the editor or a
+//  menu, isn't owed to the game
+//
+void StartTicks (void)
+{
+    pacing.tickclock = 0;
+}
+
+
+//
+//  FrameTicks
+//  How many ms_per_tick game ticks this frame owes, so the game keeps the
+//  same speed at any present rate: 0 or 1 when frames come faster than
+//  ticks, several when slower. A frame within 1/32 of a tick counts as
+//  exactly one, so vsync near the tick rate doesn't alternate 0 and 2.
+//  A long hitch runs at most TICK_CATCHUP ticks, the rest of it is lost.
+//
+int FrameTicks (int ms_per_tick)
+{
+    Uint64 now, tick, elapsed;
+    int n;
+    
+    if (!pacing.freq)
+        pacing.freq = SDL_GetPerformanceFrequency();
+    tick = pacing.freq * ms_per_tick / 1000;
+    
+    now = SDL_GetPerformanceCounter();
+    if (!pacing.tickclock) {
+        pacing.owed = tick; // StartTicks: the first frame runs one
+    } else {
+        elapsed = now - pacing.tickclock;
+        if (elapsed > tick - tick / 32 && elapsed < tick + tick / 32)
+            elapsed = tick;
+        pacing.owed += elapsed;
+    }
+    pacing.tickclock = now;
     
-    return dt;
+    n = (int)(pacing.owed / tick);
+    if (n > TICK_CATCHUP) {
+        n = TICK_CATCHUP;
+        pacing.owed = tick * n;
+    }
+    pacing.owed -= tick * n;
+    
+    return n;
 }
 
+
 void TextColor (int c)
 {
     fgcolor = c;
@@ -82,7 +308,25 @@ void BackgroundColor (int c)
 
 void SetPaletteColor (int c)
 {
-    SDL_SetRenderDrawColor(renderer, colors[c].r, colors[c].g, colors[c].b, 255);
+    SDL_SetRenderDrawColor(renderer,
+                           colors[c].r * lightlevel / 255,
+                           colors[c].g * lightlevel / 255,
+                           colors[c].b * lightlevel / 255,
+                           255);
+}
+
+
+//
+//  SetLightLevel
+//  Scale palette and font colors by level (0-255) for lit map drawing
+//
+void SetLightLevel (int level)
+{
+    if (level == lightlevel)
+        return;
+
+    lightlevel = level;
+    SDL_SetTextureColorMod(font_table, level, level, level);
 }
 
 void SetRGBColor (uint8_t r, uint8_t g, uint8_t b)
@@ -283,10 +527,13 @@ static void CreateFontTable (void)
     uint32_t *pixel, *p;
     int y, x; // font pixel location
     extern const unsigned char fontdata[];
-    uint32_t pixels[w * h];
+    uint32_t *pixels; // too big for the stack
     SDL_PixelFormat *format;
     
-    memset(pixels, 0, w * h * sizeof(pixels[0]));
+    TraceBegin("CreateFontTable");
+    pixels = Mem_Calloc(MEM_VIDEO, w * h, sizeof(pixels[0]));
+    if (!pixels)
+        Quit("Could not alloc font pixels!");
     format = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
     font_table = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, w, h);
     SDL_SetTextureBlendMode(font_table, SDL_BLENDMODE_BLEND);
@@ -320,6 +567,8 @@ static void CreateFontTable (void)
     
     SDL_UpdateTexture(font_table, NULL, pixels, w * sizeof(pixels[0]));
     SDL_FreeFormat(format);
+    Mem_Free(pixels);
+    TraceEnd("CreateFontTable");
 }
 
 
@@ -327,6 +576,8 @@ static void CreateFontTable (void)
 
 void StartVideo (void)
 {
+    Uint32 flags;
+    
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
         Quit("Could not initialize SDL!");
     
@@ -334,11 +585,37 @@ void StartVideo (void)
     if (!window)
         Quit("Could not create game window!");
     
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_TARGETTEXTURE);
+    flags = SDL_RENDERER_TARGETTEXTURE;
+    if (pacing.mode == PRESENT_VSYNC)
+        flags |= SDL_RENDERER_PRESENTVSYNC;
+    renderer = SDL_CreateRenderer(window, -1, flags);
     if (!renderer)
         Quit("Could not create game renderer!");
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     
+    if (pacing.mode == PRESENT_VSYNC)
+    {
+        SDL_RendererInfo info;
+        SDL_DisplayMode display;
+        
+        if (SDL_GetRendererInfo(renderer, &info) || !(info.flags & SDL_RENDERER_PRESENTVSYNC)) {
+            LogWarn("StartVideo: no vsync, pacing frames instead");
+            pacing.mode = PRESENT_FREE;
+        } else {
+            // only the frame rate, FrameTicks keeps the game's speed
+            pacing.refresh = 60;
+            if (!SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &display)
+                && display.refresh_rate)
+                pacing.refresh = display.refresh_rate;
+        }
+    }
+    if (pacing.mode == PRESENT_FPS)
+        LogInfo("StartVideo: present fps, %d frames per second", pacing.fps);
+    else if (pacing.mode == PRESENT_VSYNC)
+        LogInfo("StartVideo: present vsync, %d Hz", pacing.refresh);
+    else
+        LogInfo("StartVideo: present free, %d ms frames", FRAME_RATE);
+    
     //MaxWindowSize(0); // TODO: uncomment
     SetScale(3);
     SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
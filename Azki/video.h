@@ -46,16 +46,31 @@ extern SDL_Texture * shadow_table;
 extern int windowed_scale;
 extern SDL_Rect game_res;
 
+#define PRESENT_REPORT  1800    // frames between pacing reports
+#define TICK_CATCHUP    5       // most ticks run in one frame, then the game slows
+
+typedef enum
+{
+    PRESENT_FREE,   // no vsync, sleep out each frame to a fixed schedule
+    PRESENT_VSYNC,  // present waits for the display
+    PRESENT_FPS     // as free, at a target frame rate
+} presentmode_t;
+
+void SetPresentMode (presentmode_t mode, int fps);
 void StartFrame (void);
 int  LimitFrameRate (int fps);
+void StartTicks (void);
+int  FrameTicks (int ms_per_tick);
 
 void StartVideo (void);
 void ShutdownVideo (void);
 void ToggleFullscreen (void);
 void UpdateDrawLocations (float scl);
 
+const SDL_Color * PaletteColor (int c);
 void SetPaletteColor (int c);
 void SetRGBColor (uint8_t r, uint8_t g, uint8_t b);
+void SetLightLevel (int level);
 void SetScale (int scl);
 void TextColor (int c);
 void BackgroundColor (int c);
@@ -0,0 +1,387 @@
+//
+//  watch.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Hot reload: a thread watches the maps directory (inotify on Linux,
+//  otherwise by checking the numbered map files every WATCH_POLL_MS) and
+//  posts an event for each map file that changes. The main loop passes
+//  it to Watch_HandleEvent, which diffs the new file against the one the
+//  current map was loaded from and changes only the tiles that differ.
+//
+//  In play, the tiles that differ are changed on the live map and
+//  entities that haven't been touched are left alone: an entity whose
+//  start tile changed is removed only if it's still standing there, and
+//  new entities are spawned. The player is never moved. A restart
+//  reloads the level from disk.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+#include "watch.h"
+#include "azki.h"
+#include "map.h"
+#include "mapcodec.h"
+#include "levels.h"
+#include "mapindex.h"
+#include "writer.h"
+#include "undo.h"
+#include "world.h"
+#include "rewind.h"
+#include "light.h"
+#include "mem.h"
+#include "log.h"
+
+#define WATCH_DIR_LEN   96
+#define WATCH_NAME_LEN  32      // a map file's name in watchdir
+#define WATCH_PATH_LEN  (WATCH_DIR_LEN + 1 + WATCH_NAME_LEN)
+
+static SDL_Thread * thread;
+static SDL_atomic_t running;
+static Uint32       watchevent = (Uint32)-1;
+static char         watchdir[WATCH_DIR_LEN];
+
+
+
+#pragma mark - Watching
+
+static bool IsMapFile (const char *name)
+{
+    size_t len;
+
+    len = strlen(name);
+    return len > 4 && !strcmp(name + len - 4, ".map");
+}
+
+
+static void PostChange (const char *name)
+{
+    SDL_Event event;
+    char *path;
+
+    path = Mem_Alloc(MEM_MISC, WATCH_PATH_LEN);
+    if (!path)
+        return;
+    snprintf(path, WATCH_PATH_LEN, "%s/%s", watchdir, name);
+
+    memset(&event, 0, sizeof(event));
+    event.type = watchevent;
+    event.user.data1 = path;
+    if (SDL_PushEvent(&event) != 1)
+        Mem_Free(path);
+}
+
+
+#ifdef __linux__
+
+static int WatchThread (void *data)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    struct pollfd pfd;
+    ssize_t len;
+    char *p;
+    int fd;
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1 || inotify_add_watch(fd, watchdir, IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        LogWarn("Watch: couldn't watch %s, no hot reload", watchdir);
+        if (fd != -1)
+            close(fd);
+        return 0;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (SDL_AtomicGet(&running))
+    {
+        if (poll(&pfd, 1, 250) <= 0)
+            continue;
+
+        while ((len = read(fd, buf, sizeof(buf))) > 0)
+        {
+            for (p = buf ; p < buf + len ; p += sizeof(*ev) + ev->len)
+            {
+                ev = (const struct inotify_event *)p;
+                if (ev->len && IsMapFile(ev->name))
+                    PostChange(ev->name);
+            }
+        }
+    }
+
+    close(fd);
+    return 0;
+}
+
+#else
+
+//
+//  WatchThread
+//  No inotify: check the size and time of each numbered map file
+//
+static int WatchThread (void *data)
+{
+    static struct
+    {
+        bool    exists;
+        time_t  mtime;
+        off_t   size;
+    } seen[MAX_LEVELS + 1];
+    struct stat st;
+    char name[WATCH_NAME_LEN];
+    char path[WATCH_PATH_LEN];
+    bool first, exists;
+    int num;
+
+    first = true;
+    while (SDL_AtomicGet(&running))
+    {
+        for (num=1 ; num<=MAX_LEVELS ; num++)
+        {
+            snprintf(name, sizeof(name), "%d.map", num);
+            snprintf(path, sizeof(path), "%s/%s", watchdir, name);
+            exists = stat(path, &st) == 0;
+            if (exists && !first && (!seen[num].exists
+                                     || seen[num].mtime != st.st_mtime
+                                     || seen[num].size != st.st_size))
+                PostChange(name);
+
+            seen[num].exists = exists;
+            if (exists) {
+                seen[num].mtime = st.st_mtime;
+                seen[num].size = st.st_size;
+            }
+        }
+        first = false;
+        SDL_Delay(WATCH_POLL_MS);
+    }
+
+    return 0;
+}
+
+#endif
+
+
+
+#pragma mark - Reloading
+
+static void RemoveEntityAt (objtype_t type, tile x, tile y)
+{
+    obj_t **objs;
+    int i, count;
+
+    objs = List_ObjectsOfType(type, &count);
+    for (i=0 ; i<count ; i++)
+    {
+        if (objs[i]->x == x && objs[i]->y == y && objs[i]->state != objst_remove) {
+            objs[i]->state = objst_remove;
+            return;
+        }
+    }
+}
+
+
+//
+//  ChangeLiveTile
+//  A foreground tile changed from old to new while playing
+//
+static void ChangeLiveTile (obj_t *live, const obj_t *old, obj_t *new)
+{
+    if (old->type == TYPE_PLAYER || new->type == TYPE_PLAYER)
+        return;
+
+    if (old->flags & OF_ENTITY)
+        RemoveEntityAt(old->type, old->x, old->y);
+
+    if (new->flags & OF_ENTITY) {
+        new->serial = new->y * MAP_W + new->x + 1;
+        List_AddObject(new);
+        *live = NewObjectFromDef(TYPE_NONE, new->x, new->y);
+    } else {
+        *live = *new;
+    }
+}
+
+
+//
+//  ReloadMap
+//  A map file changed on disk
+//
+static void ReloadMap (const char *path)
+{
+    static byte     data[MAPFILE_MAX];
+    static map_t    newmap;
+    static map_t    oldmap;
+    levelinfo_t *   info;
+    const byte *    base;
+    FILE *          file;
+    size_t          size, basesize;
+    obj_t *         live;
+    obj_t *         old;
+    obj_t *         new;
+    bool            playing, hasbase;
+    int             num, layer, i, count;
+    void            EditorReloaded (const map_t *, const map_t *, const byte *, size_t);
+
+    info = NULL;
+    count = 0;
+    for (i=0, info=LevelList(&count) ; i<count ; i++, info++)
+        if (!strcmp(info->file, path))
+            break;
+    if (i == count)
+    {
+        info = NULL;
+        if (sscanf(path + strlen(watchdir) + 1, "%d.map", &num) != 1)
+            return;
+    }
+    else
+    {
+        num = info->num;
+    }
+
+    // our own save, still being written
+    if (Writer_PendingData(path, data, sizeof(data), &size))
+        return;
+
+    file = fopen(path, "rb");
+    if (!file)
+        return;
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    // nothing new, or it's our own save
+    if (info && info->size == size && info->crc == CRC32(data, size))
+        return;
+
+    if (!DecodeMap(data, size, num, &newmap)) {
+        LogWarn("Watch: %s changed but doesn't load, ignored", path);
+        return;
+    }
+
+    UpdateLevelInfo(num, data, (uint32_t)size);
+    Index_UpdateMap(&newmap, CRC32(data, size));
+    if (num != map.num) {
+        LogInfo("Watch: level %d changed on disk", num);
+        return;
+    }
+
+    // testing from the editor: its map, kept aside, gets the change too
+    base = LoadedMapFile(&basesize);
+    hasbase = base && DecodeMap(base, basesize, num, &oldmap);
+    EditorReloaded(hasbase ? &oldmap : NULL, &newmap, data, size);
+
+    // dead: the restart will load it
+    if (state == STATE_GAMEOVER || (state == STATE_LEVELSCREEN && restartlevel)) {
+        W_DiscardSnapshot();
+        LogInfo("Watch: level %d changed, loaded on restart", num);
+        return;
+    }
+
+    playing = state == STATE_PLAY;
+    if (!hasbase)
+    {
+        // nothing to diff against
+        if (playing) {
+            LogInfo("Watch: level %d changed, restart to see it", num);
+            W_DiscardSnapshot();
+        } else {
+            memcpy(&map, &newmap, sizeof(map));
+            SetLoadedMapFile(data, size);
+        }
+        return;
+    }
+
+    count = 0;
+    for (layer=0 ; layer<2 ; layer++)
+    {
+        live = layer ? &map.background[0][0] : &map.foreground[0][0];
+        old = layer ? &oldmap.background[0][0] : &oldmap.foreground[0][0];
+        new = layer ? &newmap.background[0][0] : &newmap.foreground[0][0];
+        for (i=0 ; i<MAP_W*MAP_H ; i++, live++, old++, new++)
+        {
+            // both are fresh decodes, so any difference is a change
+            if (!memcmp(old, new, sizeof(obj_t)))
+                continue;
+
+            if (playing && layer == 0)
+                ChangeLiveTile(live, old, new);
+            else
+                *live = *new;
+            count++;
+        }
+    }
+
+    SetLoadedMapFile(data, size);
+    if (state == STATE_EDIT)
+        Undo_Clear(); // the history is of tiles that may have changed
+    if (playing)
+    {
+        W_DiscardSnapshot();
+        R_Reset();
+        L_InitLighting();
+    }
+
+    LogInfo("Watch: reloaded level %d, %d tiles changed", num, count);
+}
+
+
+
+#pragma mark -
+
+//
+//  Watch_Start
+//  Start watching dir for changed map files
+//
+void Watch_Start (const char *dir)
+{
+    if (thread)
+        return;
+
+    watchevent = SDL_RegisterEvents(1);
+    if (watchevent == (Uint32)-1)
+        return;
+
+    snprintf(watchdir, sizeof(watchdir), "%s", dir);
+    SDL_AtomicSet(&running, 1);
+    thread = SDL_CreateThread(WatchThread, "watch", NULL);
+    if (!thread)
+        LogWarn("Watch_Start: couldn't start thread, no hot reload");
+}
+
+
+void Watch_Shutdown (void)
+{
+    if (!thread)
+        return;
+
+    SDL_AtomicSet(&running, 0);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+}
+
+
+//
+//  Watch_HandleEvent
+//  Call for events the loop doesn't handle, returns true if it was a
+//  map change
+//
+bool Watch_HandleEvent (SDL_Event *event)
+{
+    if (event->type != watchevent)
+        return false;
+
+    ReloadMap(event->user.data1);
+    Mem_Free(event->user.data1);
+    return true;
+}
@@ -0,0 +1,21 @@
+//
+//  watch.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef watch_h
+#define watch_h
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+#define WATCH_POLL_MS   500     // without inotify, how often files are checked
+
+void Watch_Start (const char *dir);
+void Watch_Shutdown (void);
+bool Watch_HandleEvent (SDL_Event *event);
+
+#endif /* watch_h */
@@ -0,0 +1,155 @@
+//
+//  world.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Everything PlayLoop simulates lives in a handful of fixed blocks of
+//  memory: the map layers, the entity table and list head, the player
+//  and the random number generator. A snapshot is all of them copied
+//  back to back into one buffer, so restoring a level is a few memcpys.
+
+#include <SDL2/SDL.h>
+#include <string.h>
+#include "world.h"
+#include "map.h"
+#include "player.h"
+#include "cmdlib.h"
+#include "mem.h"
+#include "log.h"
+
+#define MAX_REGIONS 8
+
+static worldregion_t    regions[MAX_REGIONS];
+static int              numregions;
+static size_t           statesize;
+
+static byte *           snapshot;
+static bool             snapshotvalid;
+
+
+
+static void AddRegion (void *data, size_t size)
+{
+    if (numregions == MAX_REGIONS)
+        Quit("AddRegion: too many world regions");
+    
+    regions[numregions].data = data;
+    regions[numregions].size = size;
+    numregions++;
+    statesize += size;
+}
+
+
+static void InitRegions (void)
+{
+    void *data;
+    size_t size;
+    
+    if (numregions)
+        return;
+    
+    AddRegion(&map, sizeof(map));
+    data = List_TableState(&size);
+    AddRegion(data, size);
+    AddRegion(&objlist, sizeof(objlist));
+    AddRegion(&player, sizeof(player));
+    AddRegion(&sword_dir, sizeof(sword_dir));
+    AddRegion(&tics, sizeof(tics));
+    data = RandomState(&size);
+    AddRegion(data, size);
+}
+
+
+worldregion_t * W_Regions (int *count)
+{
+    InitRegions();
+    *count = numregions;
+    return regions;
+}
+
+
+size_t W_StateSize (void)
+{
+    InitRegions();
+    return statesize;
+}
+
+
+
+#pragma mark - Snapshots
+
+static float ElapsedMS (uint64_t start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0f
+        / SDL_GetPerformanceFrequency();
+}
+
+
+//
+//  W_CaptureSnapshot
+//  Save the whole play state, call at the start of a level
+//
+void W_CaptureSnapshot (void)
+{
+    uint64_t start;
+    byte *dst;
+    int i;
+    
+    InitRegions();
+    if (!snapshot)
+    {
+        snapshot = Mem_Alloc(MEM_WORLD, statesize);
+        if (!snapshot)
+            Quit("W_CaptureSnapshot: could not alloc snapshot");
+    }
+    
+    start = SDL_GetPerformanceCounter();
+    dst = snapshot;
+    for (i=0 ; i<numregions ; i++)
+    {
+        memcpy(dst, regions[i].data, regions[i].size);
+        dst += regions[i].size;
+    }
+    snapshotvalid = true;
+    
+    LogInfo("snapshot: captured %zu bytes in %.3f ms", statesize, ElapsedMS(start));
+}
+
+
+//
+//  W_RestoreSnapshot
+//  Put the play state back to the last snapshot,
+//  returns false if there isn't one
+//
+bool W_RestoreSnapshot (void)
+{
+    uint64_t start;
+    byte *src;
+    int i;
+    
+    if (!snapshotvalid)
+        return false;
+    
+    start = SDL_GetPerformanceCounter();
+    src = snapshot;
+    for (i=0 ; i<numregions ; i++)
+    {
+        memcpy(regions[i].data, src, regions[i].size);
+        src += regions[i].size;
+    }
+    
+    LogInfo("snapshot: restored %zu bytes in %.3f ms", statesize, ElapsedMS(start));
+    return true;
+}
+
+
+//
+//  W_DiscardSnapshot
+//  The level changed, the snapshot no longer applies
+//
+void W_DiscardSnapshot (void)
+{
+    snapshotvalid = false;
+}
@@ -0,0 +1,29 @@
+//
+//  world.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef world_h
+#define world_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// a block of memory that is part of the play state
+typedef struct
+{
+    void *  data;
+    size_t  size;
+} worldregion_t;
+
+worldregion_t * W_Regions (int *count);
+size_t  W_StateSize (void);
+
+void    W_CaptureSnapshot (void);
+bool    W_RestoreSnapshot (void);
+void    W_DiscardSnapshot (void);
+
+#endif /* world_h */
@@ -0,0 +1,402 @@
+//
+//  writer.c
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  File writes are copied into a queue and done in order on a writer
+//  thread, so the editor never waits on the disk. A replaced file is
+//  written to path.tmp, synced and renamed over path, so a crash leaves
+//  either the old file or the new one, never half of one. Until a
+//  replace is done, Writer_PendingData hands out the queued copy so a
+//  read right after a save sees it.
+//
+//  An append to the same path as the newest queued job, one the thread
+//  hasn't started on, is added onto that job rather than taking a slot,
+//  so the journal's once a frame appends don't fill the queue while the
+//  disk is slow. Only MAX_WRITES saves and the like queued at once wait.
+//
+//  Without the thread (tools, or before Writer_Start) writes happen
+//  right away.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "writer.h"
+#include "azki.h"
+#include "mem.h"
+#include "log.h"
+
+#define WRITE_PATH_LEN  128
+
+typedef enum
+{
+    WRITE_REPLACE,
+    WRITE_APPEND,
+    WRITE_REMOVE
+} writetype_t;
+
+typedef struct
+{
+    writetype_t type;
+    int         flags;
+    char        path[WRITE_PATH_LEN];
+    void *      data;
+    size_t      size;
+} writejob_t;
+
+static writejob_t   jobs[MAX_WRITES];
+static int          head;       // oldest job, the one being written
+static int          numjobs;
+
+static SDL_Thread * thread;
+static SDL_mutex *  lock;
+static SDL_cond *   jobready;
+static SDL_cond *   jobdone;
+static bool         running;
+
+static bool         failedsince;    // since the last WF_IFNOFAIL job
+static bool         failed;         // ever
+
+
+
+#pragma mark - Writing
+
+static bool SyncFile (FILE *file)
+{
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+
+static bool ReplaceFile (const char *path, const void *data, size_t size)
+{
+    char temp[WRITE_PATH_LEN + 4];
+    FILE *file;
+    bool ok;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    file = fopen(temp, "wb");
+    if (!file) {
+        LogError("ReplaceFile: couldn't open %s!", temp);
+        return false;
+    }
+
+    ok = size == 0 || fwrite(data, size, 1, file) == 1;
+    ok = ok && fflush(file) == 0 && SyncFile(file);
+    if (fclose(file) != 0)
+        ok = false;
+
+#ifdef _WIN32
+    if (ok)
+        remove(path); // rename won't replace on Windows
+#endif
+    if (ok && rename(temp, path) != 0)
+        ok = false;
+
+    if (!ok) {
+        LogError("ReplaceFile: couldn't write %s!", path);
+        remove(temp);
+    }
+    return ok;
+}
+
+
+// the journal only has to survive the game crashing, not the OS,
+// so appends aren't synced
+static bool AppendFile (const char *path, const void *data, size_t size)
+{
+    FILE *file;
+    bool ok;
+
+    file = fopen(path, "ab");
+    if (!file) {
+        LogError("AppendFile: couldn't open %s!", path);
+        return false;
+    }
+
+    ok = fwrite(data, size, 1, file) == 1;
+    if (fclose(file) != 0)
+        ok = false;
+    return ok;
+}
+
+
+static void DoJob (writejob_t *job)
+{
+    bool ok;
+
+    if (job->flags & WF_IFNOFAIL)
+    {
+        ok = !failedsince;
+        failedsince = false;
+        if (!ok) {
+            LogWarn("Writer: skipped %s after a failed write", job->path);
+            return;
+        }
+    }
+
+    switch (job->type)
+    {
+        case WRITE_REPLACE:
+            ok = ReplaceFile(job->path, job->data, job->size);
+            break;
+        case WRITE_APPEND:
+            ok = AppendFile(job->path, job->data, job->size);
+            break;
+        case WRITE_REMOVE:
+            remove(job->path);
+            ok = true;
+            break;
+        default:
+            ok = false;
+            break;
+    }
+
+    if (!ok)
+        failed = failedsince = true;
+}
+
+
+static int WriterThread (void *data)
+{
+    writejob_t *job;
+
+    SDL_LockMutex(lock);
+    while (1)
+    {
+        while (!numjobs && running)
+            SDL_CondWait(jobready, lock);
+        if (!numjobs)
+            break; // shutting down
+
+        // the job stays queued while it's written
+        job = &jobs[head];
+        SDL_UnlockMutex(lock);
+        DoJob(job);
+        SDL_LockMutex(lock);
+
+        Mem_Free(job->data);
+        job->data = NULL;
+        head = (head + 1) % MAX_WRITES;
+        numjobs--;
+        SDL_CondBroadcast(jobdone);
+    }
+    SDL_UnlockMutex(lock);
+
+    return 0;
+}
+
+
+
+#pragma mark -
+
+void Writer_Start (void)
+{
+    if (thread)
+        return;
+
+    lock = SDL_CreateMutex();
+    jobready = SDL_CreateCond();
+    jobdone = SDL_CreateCond();
+    if (!lock || !jobready || !jobdone)
+        Quit("Writer_Start: could not create mutex");
+
+    running = true;
+    thread = SDL_CreateThread(WriterThread, "writer", NULL);
+    if (!thread) {
+        LogWarn("Writer_Start: no writer thread, writing synchronously");
+        running = false;
+    }
+}
+
+
+//
+//  Writer_Shutdown
+//  Finish all queued writes and stop the thread
+//
+void Writer_Shutdown (void)
+{
+    if (!thread)
+        return;
+
+    SDL_LockMutex(lock);
+    running = false;
+    SDL_CondSignal(jobready);
+    SDL_UnlockMutex(lock);
+
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+}
+
+
+//
+//  MergeAppend
+//  Add data onto the newest queued job if it's an append to path that
+//  isn't being written yet. Call with the lock held.
+//
+static bool MergeAppend (const char *path, const void *data, size_t size)
+{
+    writejob_t *tail;
+    void *grown;
+
+    if (numjobs < 2) // just the one being written, or none
+        return false;
+
+    tail = &jobs[(head + numjobs - 1) % MAX_WRITES];
+    if (tail->type != WRITE_APPEND || tail->flags || strcmp(tail->path, path))
+        return false;
+
+    grown = Mem_Realloc(MEM_MAPS, tail->data, tail->size + size);
+    if (!grown)
+        return false;
+    memcpy((char *)grown + tail->size, data, size);
+    tail->data = grown;
+    tail->size += size;
+    return true;
+}
+
+
+static void AddJob (writetype_t type, const char *path, const void *data, size_t size, int flags)
+{
+    writejob_t job;
+    writejob_t *slot;
+
+    if (strlen(path) >= WRITE_PATH_LEN) {
+        LogError("Writer: path too long: %s", path);
+        return;
+    }
+
+    if (thread && type == WRITE_APPEND && !flags)
+    {
+        SDL_LockMutex(lock);
+        if (MergeAppend(path, data, size)) {
+            SDL_UnlockMutex(lock);
+            return;
+        }
+        SDL_UnlockMutex(lock);
+    }
+
+    job.type = type;
+    job.flags = flags;
+    strcpy(job.path, path);
+    job.size = size;
+    job.data = NULL;
+    if (size)
+    {
+        job.data = Mem_Alloc(MEM_MAPS, size);
+        if (!job.data)
+            Quit("Writer: could not alloc write");
+        memcpy(job.data, data, size);
+    }
+
+    if (!thread)
+    {
+        DoJob(&job);
+        Mem_Free(job.data);
+        return;
+    }
+
+    SDL_LockMutex(lock);
+    if (numjobs == MAX_WRITES)
+    {
+        LogWarn("Writer: queue full, waiting");
+        while (numjobs == MAX_WRITES)
+            SDL_CondWait(jobdone, lock);
+    }
+    slot = &jobs[(head + numjobs) % MAX_WRITES];
+    *slot = job;
+    numjobs++;
+    SDL_CondSignal(jobready);
+    SDL_UnlockMutex(lock);
+}
+
+
+//
+//  Writer_Replace
+//  Atomically replace path's contents with a copy of data
+//
+void Writer_Replace (const char *path, const void *data, size_t size)
+{
+    AddJob(WRITE_REPLACE, path, data, size, 0);
+}
+
+
+void Writer_Append (const char *path, const void *data, size_t size, int flags)
+{
+    AddJob(WRITE_APPEND, path, data, size, flags);
+}
+
+
+void Writer_Remove (const char *path)
+{
+    AddJob(WRITE_REMOVE, path, NULL, 0, 0);
+}
+
+
+//
+//  Writer_Flush
+//  Wait until everything queued has been written
+//
+void Writer_Flush (void)
+{
+    if (!thread)
+        return;
+
+    SDL_LockMutex(lock);
+    while (numjobs)
+        SDL_CondWait(jobdone, lock);
+    SDL_UnlockMutex(lock);
+}
+
+
+// call after Writer_Flush
+bool Writer_Failed (void)
+{
+    return failed;
+}
+
+
+//
+//  Writer_PendingData
+//  If a replace of path is still queued, copy the newest one into
+//  buffer and return true. Safe from any thread.
+//
+bool Writer_PendingData (const char *path, void *buffer, size_t bufsize, size_t *size)
+{
+    writejob_t *job;
+    bool found;
+    int i;
+
+    if (!thread)
+        return false;
+
+    found = false;
+    SDL_LockMutex(lock);
+    for (i=numjobs-1 ; i>=0 ; i--)
+    {
+        job = &jobs[(head + i) % MAX_WRITES];
+        if (job->type == WRITE_APPEND || strcmp(job->path, path))
+            continue;
+        if (job->type == WRITE_REPLACE && job->size <= bufsize) {
+            memcpy(buffer, job->data, job->size);
+            *size = job->size;
+            found = true;
+        }
+        break; // newest write of path decides
+    }
+    SDL_UnlockMutex(lock);
+
+    return found;
+}
@@ -0,0 +1,29 @@
+//
+//  writer.h
+//  Azki
+//
+//  Created by agent on 10/19/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#ifndef writer_h
+#define writer_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAX_WRITES      32      // queued jobs before Writer_ calls wait, appends merge
+
+// job flags
+#define WF_IFNOFAIL     0x01    // skip if any write failed since the last one
+
+void Writer_Start (void);
+void Writer_Shutdown (void);
+void Writer_Replace (const char *path, const void *data, size_t size);
+void Writer_Append (const char *path, const void *data, size_t size, int flags);
+void Writer_Remove (const char *path);
+void Writer_Flush (void);
+bool Writer_Failed (void);
+bool Writer_PendingData (const char *path, void *buffer, size_t bufsize, size_t *size);
+
+#endif /* writer_h */